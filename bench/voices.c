@@ -0,0 +1,235 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <time.h>
+
+#include "synth.h"
+
+/*
+ * Mix cost per voice: the pointer-chasing layout of the original front-end
+ * (individually malloc'd notes behind a pointer array, envelopes and
+ * oscillators recomputed from the time on every sample) against the engine
+ * with structure-of-arrays voices.
+ *
+ * Notes are held for the whole run, which is shorter than the bell decay,
+ * so both sides render every voice on every sample.
+ */
+
+// -------------------------- +Const --------------------------
+
+#define       PI                    ((float) M_PI)
+
+#define       SAMPLE_RATE           44100
+#define       SAMPLE_TIME           (1.0f / (float) SAMPLE_RATE)
+#define       FRAMES                512
+#define       BLOCKS                60
+#define       PASSES                3
+
+const int     g_voicesNums[]        = { 64, 128, 256, 512 };
+
+#define       VOICES_NUMS_NUM       ((int) (sizeof(g_voicesNums) / sizeof(g_voicesNums[0])))
+
+// -------------------------- +Legacy --------------------------
+
+extern inline float synth_legacyConvertFrequency(const float hertz) { return hertz * 2.0f * PI; }
+extern inline float synth_legacyScaleNote(const int note) { return 256 * powf(1.0594630943592952645618252949463f, note); }
+
+struct synth_Note
+{
+    int id;
+    float on;
+    float off;
+    int channel;
+};
+
+enum synth_WaveType
+{
+    WAVE_TYPE_SINE,
+    WAVE_TYPE_SQUARE,
+    WAVE_TYPE_NOISE
+};
+
+struct synth_Envelope
+{
+    float attackTime;
+    float decayTime;
+    float releaseTime;
+    float startAmplitude;
+    float sustainAmplitude;
+};
+
+const struct synth_Envelope g_envelopeBell = { 0.01f, 1.0f, 1.0f, 1.0f, 0.0f };
+const struct synth_Envelope g_envelopeHarmonica = { 0.05f, 1.0f, 0.1f, 1.0f, 0.95f };
+
+float synth_legacyOscillate(const float time, const float freq, const enum synth_WaveType type, const float lfoFreq, const float lfoAmplitude)
+{
+    const float dFreq = synth_legacyConvertFrequency(freq) * time + lfoAmplitude * freq * (sinf(synth_legacyConvertFrequency(lfoFreq) * time));
+    switch (type) {
+        case WAVE_TYPE_SINE: return sinf(dFreq);
+        case WAVE_TYPE_SQUARE: return sinf(dFreq) > 0 ? 1.0f : -1.0f;
+        case WAVE_TYPE_NOISE: return 2.0f * ((float) random() / (float) RAND_MAX) - 1.0f;
+    }
+    return 0.0f;
+}
+
+float synth_legacyGetAmplitude(const struct synth_Envelope *envelope, const float time, const float timeOn, const float timeOff)
+{
+    float amplitude;
+    if (timeOn > timeOff) {
+        const float lifetime = time - timeOn;
+        if (lifetime <= envelope->attackTime) {
+            amplitude = (lifetime / envelope->attackTime) * envelope->startAmplitude;
+        } else if (lifetime <= (envelope->attackTime + envelope->decayTime)) {
+            amplitude = ((lifetime - envelope->attackTime) / envelope->decayTime) * (envelope->sustainAmplitude - envelope->startAmplitude) + envelope->startAmplitude;
+        } else {
+            amplitude = envelope->sustainAmplitude;
+        }
+    } else {
+        amplitude = 0.0f;
+    }
+    return amplitude <= FLT_EPSILON ? 0.0f : amplitude;
+}
+
+float synth_legacyVoice(const struct synth_Note *note, const float time)
+{
+    if (note->channel == 0) {
+        const float amplitude = synth_legacyGetAmplitude(&g_envelopeHarmonica, time, note->on, note->off);
+        if (amplitude <= 0.0f) {
+            return 0.0f;
+        }
+        const float sound =
+                + 1.00f * synth_legacyOscillate(time, synth_legacyScaleNote(note->id), WAVE_TYPE_SQUARE, 5.0f, 0.001f)
+                + 0.50f * synth_legacyOscillate(time, synth_legacyScaleNote(note->id + 12), WAVE_TYPE_SQUARE, 0.0f, 0.0f)
+                + 0.05f * synth_legacyOscillate(time, synth_legacyScaleNote(note->id + 24), WAVE_TYPE_NOISE, 0.0f, 0.0f);
+        return amplitude * sound * 0.5f;
+    }
+    const float amplitude = synth_legacyGetAmplitude(&g_envelopeBell, time, note->on, note->off);
+    if (amplitude <= 0.0f) {
+        return 0.0f;
+    }
+    const float sound =
+            + 1.00f * synth_legacyOscillate(time, synth_legacyScaleNote(note->id + 12), WAVE_TYPE_SINE, 5.0f, 0.001f)
+            + 0.50f * synth_legacyOscillate(time, synth_legacyScaleNote(note->id + 24), WAVE_TYPE_SINE, 0.0f, 0.0f)
+            + 0.25f * synth_legacyOscillate(time, synth_legacyScaleNote(note->id + 36), WAVE_TYPE_SINE, 0.0f, 0.0f);
+    return amplitude * sound * 0.5f;
+}
+
+// -------------------------- +Bench --------------------------
+
+double synth_benchGetTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e+9;
+}
+
+float g_sink = 0.0f;
+
+// Seconds for BLOCKS blocks of the pointer-chasing mix
+double synth_benchLegacy(const int voicesNum)
+{
+    struct synth_Note **notes = malloc(voicesNum * sizeof(struct synth_Note *));
+    void **gaps = malloc(voicesNum * sizeof(void *));
+    assert(notes != NULL && gaps != NULL);
+    // Allocations in between scatter the notes over the heap like a long session does
+    for (int i = 0; i < voicesNum; i++) {
+        notes[i] = malloc(sizeof(struct synth_Note));
+        gaps[i] = malloc(64 + (i * 37) % 256);
+        assert(notes[i] != NULL && gaps[i] != NULL);
+        notes[i]->id = 24 + (i / SYNTH_PARTS_NUM) % 48;
+        notes[i]->on = 0.0f;
+        notes[i]->off = -1.0f;
+        notes[i]->channel = i % 2;
+    }
+    float buffer[FRAMES];
+    float time = 0.0f;
+    const double start = synth_benchGetTime();
+    for (int b = 0; b < BLOCKS; b++) {
+        for (int i = 0; i < FRAMES; i++) {
+            float mixed = 0.0f;
+            for (int n = 0; n < voicesNum; n++) {
+                mixed += synth_legacyVoice(notes[n], time);
+            }
+            buffer[i] = mixed;
+            time += SAMPLE_TIME;
+        }
+        g_sink += buffer[FRAMES - 1];
+    }
+    const double elapsed = synth_benchGetTime() - start;
+    for (int i = 0; i < voicesNum; i++) {
+        free(notes[i]);
+        free(gaps[i]);
+    }
+    free(notes);
+    free(gaps);
+    return elapsed;
+}
+
+// Seconds for BLOCKS blocks of the engine, voices spread over all parts
+double synth_benchEngine(const int voicesNum)
+{
+    struct synth_EngineConfig config;
+    synth_engineConfigDefault(&config);
+    config.sampleRate = SAMPLE_RATE;
+    config.voicesNum = voicesNum;
+    config.maxFrames = FRAMES;
+    // The governor stays out of the way, every voice renders at full quality
+    config.loadReduce = FLT_MAX;
+    config.loadCheap = FLT_MAX;
+    config.loadSteal = FLT_MAX;
+    struct synth_Engine *engine = synth_engineCreate(&config);
+    assert(engine != NULL);
+    for (int part = 0; part < SYNTH_PARTS_NUM; part++) {
+        synth_engineSetPartPatch(engine, part, part % 2 == 0 ? SYNTH_PATCH_HARMONICA : SYNTH_PATCH_BELL);
+    }
+    float output[FRAMES * SYNTH_OUTPUT_CHANNELS];
+    for (int i = 0; i < voicesNum; i++) {
+        // A single frame drains the queue before it fills up
+        while (!synth_engineNoteOn(engine, i % SYNTH_PARTS_NUM, 24 + (i / SYNTH_PARTS_NUM) % 48)) {
+            synth_engineRender(engine, output, 1);
+        }
+    }
+    const double start = synth_benchGetTime();
+    for (int b = 0; b < BLOCKS; b++) {
+        synth_engineRender(engine, output, FRAMES);
+        g_sink += output[FRAMES - 1];
+    }
+    const double elapsed = synth_benchGetTime() - start;
+    struct synth_EngineStats stats;
+    synth_engineGetStats(engine, &stats);
+    if (stats.voices != voicesNum) {
+        printf("warning: %d of %d voices active\n", stats.voices, voicesNum);
+    }
+    synth_engineDestroy(engine);
+    return elapsed;
+}
+
+double synth_benchBest(double (*bench)(int), const int voicesNum)
+{
+    double best = bench(voicesNum);
+    for (int i = 1; i < PASSES; i++) {
+        const double elapsed = bench(voicesNum);
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+int main()
+{
+    printf("%8s %16s %16s %10s\n", "voices", "legacy ns/voice", "soa ns/voice", "speedup");
+    for (int i = 0; i < VOICES_NUMS_NUM; i++) {
+        const int voicesNum = g_voicesNums[i];
+        const double samples = (double) voicesNum * FRAMES * BLOCKS;
+        const double legacy = synth_benchBest(synth_benchLegacy, voicesNum) / samples * 1e+9;
+        const double soa = synth_benchBest(synth_benchEngine, voicesNum) / samples * 1e+9;
+        printf("%8d %16.2f %16.2f %9.1fx\n", voicesNum, legacy, soa, legacy / soa);
+    }
+    return g_sink == 12345.0f;
+}
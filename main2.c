@@ -1,11 +1,27 @@
 #include <assert.h>
+#include <math.h>
+#include <signal.h>
 #include <stdbool.h>
-#include <float.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "c11threads.h"
 
 #include "SDL2/SDL.h"
 
+#include "synth.h"
+#include "synth_log.h"
+#include "synth_rt.h"
+#include "synth_control.h"
+#include "synth_shm.h"
+#include "synth_tap.h"
+#include "synth_fft.h"
+#include "synth_converter.h"
+
 // -------------------------- +Const --------------------------
 
 SDL_Window    *g_window             = NULL;
@@ -15,25 +31,129 @@ SDL_Renderer  *g_renderer           = NULL;
 #define       SAMPLES               512
 
 #define       TICK_TIME             (1.0f / 60.0f)
-#define       SAMPLE_TIME           (1.0f / (float) FREQUENCY)
 
-#define       AUDIO_DEV_ID          1
+#define       AUDIO_BUFFER_SIZE     2048
+
+atomic_bool   g_quit                = false;
+
+// Which subsystems come up: window and keyboard, audio only, or none with a file as output
+enum synth_AppProfile
+{
+    APP_PROFILE_GUI,
+    APP_PROFILE_AUDIO,
+    APP_PROFILE_OFFLINE
+};
+
+enum synth_AppProfile g_profile     = APP_PROFILE_GUI;
 
-#define       PI                    ((float) M_PI)
+const char    *g_offlinePath        = "synth.wav";
+float         g_offlineSeconds      = 10.0f;
 
-char          g_logBuffer[1024];
+#define       STARTUP_PHASES_MAX    16
+
+struct synth_AppPhase
+{
+    const char *name;
+    double millis;
+};
 
-bool          g_quit                = false;
+struct synth_AppPhase g_startupPhases[STARTUP_PHASES_MAX];
+int           g_startupPhasesNum    = 0;
+double        g_startupMark         = 0.0;
 
-float         g_audioBuffer[2048];
+float         g_audioBuffer[AUDIO_BUFFER_SIZE * SYNTH_OUTPUT_CHANNELS];
 
 #define       KEYS_NUM              16
 const char    *g_keys               = "zsxcfvgbnjmk,l./";
 
-#define       NOTES_NUM             KEYS_NUM
+int           g_keyParts[KEYS_NUM];
 
 bool          g_leftShift           = false;
 
+struct synth_Engine  *g_engine      = NULL;
+
+struct synth_RtConfig g_rtConfig;
+
+// 1 for live play, 2, 4 or 8 trade CPU for less aliasing
+int           g_oversampling        = 1;
+
+// The engine renders at its own rate and is resampled to whatever the device runs at
+int           g_internalRate        = FREQUENCY;
+enum synth_ResamplerQuality g_resamplerQuality = SYNTH_RESAMPLER_MEDIUM;
+
+// Voice mode, unison stack and glide of both keyboard parts
+enum synth_VoiceMode g_voiceMode    = SYNTH_VOICE_MODE_POLY;
+int           g_unison              = 1;
+float         g_glide               = 0.0f;
+
+// WAV file played by the unshifted keys instead of the bell
+const char    *g_samplePath         = NULL;
+
+// Unix datagram socket other processes drive the engine through
+const char    *g_controlPath        = NULL;
+struct synth_Control g_control;
+bool          g_controlled          = false;
+
+// Notes and automation of an offline render, read before it starts
+#define       SCRIPT_AHEAD          8192
+// Bytes before the samples of the largest header synth_appWavHeader writes
+#define       WAV_HEADER_MAX        58
+struct synth_AppScriptLine
+{
+    struct synth_ControlRecord record;
+    int order;
+};
+const char    *g_scriptPath         = NULL;
+struct synth_AppScriptLine *g_script = NULL;
+int           g_scriptNum           = 0;
+int           g_scriptNext          = 0;
+
+// Shared memory ring every rendered frame is copied to for local readers
+#define       SHM_FRAMES            65536
+const char    *g_shmName            = NULL;
+struct synth_ShmRing g_shmRing;
+
+// Stage table every this many seconds and a Chrome trace, both need -DSYNTH_PROFILE=ON
+float         g_profileInterval     = 0.0f;
+const char    *g_tracePath          = NULL;
+#define       TRACE_BLOCKS_MAX      256
+FILE          *g_traceFile          = NULL;
+bool          g_traceFirst          = true;
+struct synth_ProfileBlock g_traceBlocks[TRACE_BLOCKS_MAX];
+struct synth_ProfileStats g_profileLast;
+double        g_profileMark         = 0.0;
+
+SDL_AudioDeviceID g_audioDevice     = 0;
+// Set by the device callback once it runs with the real-time settings
+bool          g_audioThreadEntered  = false;
+int           g_deviceRate          = FREQUENCY;
+
+// Sample format of the device or file, auto takes what the device prefers and 16 bits for files
+bool          g_formatAuto          = true;
+enum synth_OutputFormat g_outputFormat = SYNTH_OUTPUT_F32;
+bool          g_dither              = true;
+struct synth_Converter g_converter;
+_Alignas(float) unsigned char g_outputBytes[AUDIO_BUFFER_SIZE * SYNTH_OUTPUT_CHANNELS * sizeof(float)];
+
+// Scope on top, spectrum below, redrawn every tick from the latest snapshot of the output
+#define       VIEW_WIDTH            640
+#define       VIEW_HEIGHT           400
+#define       VIEW_MIN_FREQ         20.0f
+#define       VIEW_FLOOR_DB         (-100.0f)
+// Ticks the border stays red after the output clipped
+#define       VIEW_CLIP_HOLD        60
+#define       VIEW_BINS             (SYNTH_TAP_FRAMES / 2 + 1)
+struct synth_Tap g_tap;
+struct synth_Fft g_fft;
+const float   *g_viewFrames         = NULL;
+int           g_viewClipHold        = 0;
+float         g_viewWindow[SYNTH_TAP_FRAMES];
+float         g_viewMono[SYNTH_TAP_FRAMES];
+float         g_viewRe[VIEW_BINS];
+float         g_viewIm[VIEW_BINS];
+float         g_viewDb[VIEW_BINS];
+SDL_Point     g_viewPoints[VIEW_WIDTH];
+
 // -------------------------- +Common --------------------------
 
 extern inline float synth_appGetTime()
@@ -49,236 +169,216 @@ extern inline void  synth_appSleep(const float seconds)
     thrd_sleep(&ts, NULL);
 }
 
-enum synth_LogLevel
+void synth_appSleepIfNeeded(const float start)
 {
-    LOG_LEVEL_INFO,
-    LOG_LEVEL_ERROR
-};
+    const float finish = synth_appGetTime();
+    const float sleep = TICK_TIME - (finish - start);
+    if (sleep > 0) {
+        synth_appSleep(sleep);
+    }
+}
 
-void logline(const enum synth_LogLevel level, const char *file, int line, const char *fmt, ...)
-{
-    va_list args;
-    va_start(args, fmt);
-    vsprintf(g_logBuffer, fmt, args);
-    va_end(args);
-    switch (level) {
-        case LOG_LEVEL_INFO:
-        {
-            printf("%.2f -> INFO -> %s:%d %s\n", synth_appGetTime(), file, line, g_logBuffer);
-            break;
-        }
-        case LOG_LEVEL_ERROR:
-        {
-            printf("%.2f -> ERROR -> %s:%d %s\n", synth_appGetTime(), file, line, g_logBuffer);
-            exit(-1);
-        }
+// -------------------------- +Startup --------------------------
+
+// SDL_GetTicks() only works once SDL is up, startup is measured before that
+double synth_appGetClock()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec * 1e+3 + (double) now.tv_nsec * 1e-6;
+}
+
+// Closes the phase which started at the previous mark
+void synth_appStartupMark(const char *name)
+{
+    const double now = synth_appGetClock();
+    if (g_startupPhasesNum < STARTUP_PHASES_MAX) {
+        g_startupPhases[g_startupPhasesNum++] = (struct synth_AppPhase) { name, now - g_startupMark };
     }
+    g_startupMark = now;
 }
 
-#define logi(...) logline(LOG_LEVEL_INFO, __FILE__, __LINE__, __VA_ARGS__);
-#define loge(...) logline(LOG_LEVEL_INFO, __FILE__, __LINE__, __VA_ARGS__);
+void synth_appStartupReport()
+{
+    double total = 0.0;
+    for (int i = 0; i < g_startupPhasesNum; i++) {
+        logi("Startup %-10s %8.2f ms", g_startupPhases[i].name, g_startupPhases[i].millis);
+        total += g_startupPhases[i].millis;
+    }
+    logi("Startup %-10s %8.2f ms", "total", total);
+}
 
 #define SDL_FAIL() { loge("SDL error: %s", SDL_GetError()); }
 #define SDL_ENFORCE(expr) { if ((expr) < 0)  SDL_FAIL(); }
 #define SDL_ENFORCE_PTR(ptr) { if ((ptr) == NULL) SDL_FAIL(); }
 
-// -------------------------- +Synth --------------------------
-
-extern inline float synth_convertFrequency(const float hertz) { return hertz * 2.0f * PI; }
-extern inline float synth_scaleNote(const int note) { return 256 * powf(1.0594630943592952645618252949463f, note); }
-
-struct synth_Note
-{
-    int id;
-    float on;
-    float off;
-    int channel;
-};
+// -------------------------- +Profile --------------------------
 
-mtx_t g_notesMutex;
-struct synth_Note *g_notes[] =
-{
-    NULL, NULL, NULL, NULL,
-    NULL, NULL, NULL, NULL,
-    NULL, NULL, NULL, NULL,
-    NULL, NULL, NULL, NULL
-};
+const char    *g_stageNames[SYNTH_STAGES_NUM] = { "events", "voices", " oscillator", " envelope", "mix", "output" };
 
-void synth_createNotesMutex()
+void synth_appProfileOpen()
 {
-    mtx_init(&g_notesMutex, mtx_plain);
+    struct synth_ProfileStats stats;
+    if (!synth_engineGetProfile(g_engine, &stats)) {
+        logw("The engine is built without the profiling counters, configure with -DSYNTH_PROFILE=ON");
+        g_profileInterval = 0.0f;
+        return;
+    }
+    g_profileLast = stats;
+    g_profileMark = synth_appGetClock();
+    if (g_tracePath == NULL) {
+        return;
+    }
+    g_traceFile = fopen(g_tracePath, "w");
+    if (g_traceFile == NULL) {
+        logw("Cannot open %s", g_tracePath);
+        return;
+    }
+    fprintf(g_traceFile, "{\"traceEvents\":[\n");
 }
 
-void synth_destroyNotesMutex()
+void synth_appTraceSlice(const char *name, const double start, const double duration)
 {
-    mtx_destroy(&g_notesMutex);
+    fprintf(g_traceFile, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+            g_traceFirst ? "" : ",\n", name, start, duration);
+    g_traceFirst = false;
 }
 
-enum synth_WaveType
-{
-    WAVE_TYPE_SINE,
-    WAVE_TYPE_SQUARE,
-    WAVE_TYPE_TRIANGLE,
-    WAVE_TYPE_SAW_ANALOGUE,
-    WAVE_TYPE_SAW_DIGITAL,
-    WAVE_TYPE_NOISE
-};
-
-float synth_oscillate(const float time, const float freq, const enum synth_WaveType type, const float lfoFreq, const float lfoAmplitude, const float custom)
+/*
+ * Every block is a slice at its real time. The stages are sums over the
+ * parts, they are laid out back to back inside it, the oscillator and the
+ * envelope inside the voices.
+ */
+void synth_appTraceBlocks(const struct synth_ProfileStats *stats)
 {
-    const float dFreq = synth_convertFrequency(freq) * time + lfoAmplitude * freq * (sinf(synth_convertFrequency(lfoFreq) * time));
-    switch (type) {
-        case WAVE_TYPE_SINE: // Sine wave bewteen -1 and +1
-        {
-            return sinf(dFreq);
-        }
-        case WAVE_TYPE_SQUARE: // Square wave between -1 and +1
-        {
-            return sinf(dFreq) > 0 ? 1.0f : -1.0f;
-        }
-        case WAVE_TYPE_TRIANGLE: // Triangle wave between -1 and +1
-        {
-            return asinf(sinf(dFreq)) * (2.0f / PI);
-        }
-        case WAVE_TYPE_SAW_ANALOGUE: // Saw wave (analogue / warm / slow)
-        {
-            float dOutput = 0.0;
-            float  n = 1.0f;
-            while (n < custom) {
-                dOutput += (sinf(n * dFreq)) / n;
-                n += 1.0f;
+    const double micros = 1e+6 / stats->ticksPerSecond;
+    const int num = synth_engineDrainProfile(g_engine, g_traceBlocks, TRACE_BLOCKS_MAX);
+    for (int i = 0; i < num; i++) {
+        const struct synth_ProfileBlock *block = &g_traceBlocks[i];
+        double at = (double) (block->start - stats->originTicks) * micros;
+        synth_appTraceSlice("block", at, (double) block->total * micros);
+        for (int s = 0; s < SYNTH_STAGES_NUM; s++) {
+            if (s == SYNTH_STAGE_OSCILLATOR || s == SYNTH_STAGE_ENVELOPE) {
+                continue;
             }
-            return dOutput * (2.0f / PI);
-        }
-        case WAVE_TYPE_SAW_DIGITAL:
-        {
-            return (2.0f / PI) * (freq * PI * fmodf(time, 1.0f / freq) - (PI / 2.0f));
-        }
-        case WAVE_TYPE_NOISE:
-        {
-            return 2.0f * ((float) random() / (float) RAND_MAX) - 1.0f;
-        }
-        default:
-        {
-            loge("Unknown type!");
-            return 0.0f;
+            const double duration = (double) block->ticks[s] * micros;
+            synth_appTraceSlice(g_stageNames[s], at, duration);
+            if (s == SYNTH_STAGE_VOICES) {
+                const double oscillator = (double) block->ticks[SYNTH_STAGE_OSCILLATOR] * micros;
+                synth_appTraceSlice("oscillator", at, oscillator);
+                synth_appTraceSlice("envelope", at + oscillator, (double) block->ticks[SYNTH_STAGE_ENVELOPE] * micros);
+            }
+            at += duration;
         }
     }
 }
 
-struct synth_Envelope
+// Stages over the last interval, the peaks are the worst blocks since the start
+void synth_appProfileReport(const struct synth_ProfileStats *stats, const double seconds)
 {
-    float attackTime;
-    float decayTime;
-    float releaseTime;
-    float startAmplitude;
-    float sustainAmplitude;
-};
-
-float synth_envelopeGetAmplitude(const struct synth_Envelope *envelope, const float time, const float timeOn, const float timeOff)
-{
-    assert(envelope != NULL);
-    float amplitude;
-    const bool noteIsOn = timeOn > timeOff;
-    if (noteIsOn) {
-        float lifetime = time - timeOn;
-        if (lifetime <= envelope->attackTime) {
-            amplitude = (lifetime / envelope->attackTime) * envelope->startAmplitude;
-        } else if (lifetime <= (envelope->attackTime + envelope->decayTime)) {
-            amplitude = ((lifetime - envelope->attackTime) / envelope->decayTime) * (envelope->sustainAmplitude - envelope->startAmplitude) + envelope->startAmplitude;
-        } else {
-            amplitude = envelope->sustainAmplitude;
-        }
-    } else {
-        float releaseAmplitude;
-        float lifetime = timeOff - timeOn;
-        if (lifetime <= envelope->attackTime) {
-            releaseAmplitude = (lifetime / envelope->attackTime) * envelope->startAmplitude;
-        } else if (lifetime <= (envelope->attackTime + envelope->decayTime)) {
-            releaseAmplitude = ((lifetime - envelope->attackTime) / envelope->decayTime) * (envelope->sustainAmplitude - envelope->startAmplitude) + envelope->startAmplitude;
-        } else {
-            releaseAmplitude = envelope->sustainAmplitude;
-        }
-        amplitude = ((time - timeOff) / envelope->releaseTime) * (0.0f - releaseAmplitude) + releaseAmplitude;
+    const double micros = 1e+6 / stats->ticksPerSecond;
+    const unsigned long blocks = stats->blocks - g_profileLast.blocks;
+    const uint64_t total = stats->total - g_profileLast.total;
+    if (blocks == 0 || total == 0) {
+        return;
+    }
+    const double audio = (double) (stats->frames - g_profileLast.frames) / g_internalRate;
+    logi("Render profile over %.1f s: %lu blocks, %.1f %% of the audio time", seconds, blocks, 100.0 * (double) total * micros * 1e-6 / audio);
+    logi("%-12s %10s %10s %12s %12s", "stage", "total ms", "% render", "avg us/blk", "peak us/blk");
+    for (int s = 0; s < SYNTH_STAGES_NUM; s++) {
+        const uint64_t ticks = stats->ticks[s] - g_profileLast.ticks[s];
+        logi("%-12s %10.2f %10.1f %12.2f %12.2f", g_stageNames[s], (double) ticks * micros * 1e-3, 100.0 * (double) ticks / (double) total,
+             (double) ticks * micros / (double) blocks, (double) stats->maxTicks[s] * micros);
     }
-    if (amplitude <= FLT_EPSILON) {
-        amplitude = 0.0f;
+    logi("%-12s %10.2f %10.1f %12.2f %12.2f", "block", (double) total * micros * 1e-3, 100.0,
+         (double) total * micros / (double) blocks, (double) stats->maxTotal * micros);
+    const unsigned long voiceFrames = stats->voiceFrames - g_profileLast.voiceFrames;
+    if (voiceFrames > 0) {
+        const uint64_t voices = stats->ticks[SYNTH_STAGE_VOICES] - g_profileLast.ticks[SYNTH_STAGE_VOICES];
+        logi("Voices %.1f ns per voice frame", (double) voices * micros * 1e+3 / (double) voiceFrames);
+    }
+    if (stats->missed != g_profileLast.missed) {
+        logw("Trace missed %lu blocks", stats->missed - g_profileLast.missed);
     }
-    return amplitude;
 }
 
-float synth_voiceBell(const struct synth_Envelope *envelope, const float volume, const float time, const struct synth_Note *note, bool *isFinished)
+// Called from the UI side, the render thread only ever bumps its counters
+void synth_appProfileTick(const bool last)
 {
-    assert(envelope != NULL);
-    const float amplitude = synth_envelopeGetAmplitude(envelope, time, note->on, note->off);
-    if (amplitude <= 0.0) {
-        *isFinished = true;
-        return 0.0f;
+    if (g_profileInterval <= 0.0f && g_traceFile == NULL) {
+        return;
+    }
+    struct synth_ProfileStats stats;
+    synth_engineGetProfile(g_engine, &stats);
+    if (g_traceFile != NULL) {
+        synth_appTraceBlocks(&stats);
+    }
+    const double now = synth_appGetClock();
+    const double seconds = (now - g_profileMark) * 1e-3;
+    if (g_profileInterval > 0.0f && (seconds >= g_profileInterval || last)) {
+        synth_appProfileReport(&stats, seconds);
+        g_profileLast = stats;
+        g_profileMark = now;
     }
-    const float sound =
-            + 1.00f * synth_oscillate(time, synth_scaleNote(note->id + 12), WAVE_TYPE_SINE, 5.0f, 0.001f, 50.0f)
-            + 0.50f * synth_oscillate(time, synth_scaleNote(note->id + 24), WAVE_TYPE_SINE, 0.0f, 0.0f, 50.0f)
-            + 0.25f * synth_oscillate(time, synth_scaleNote(note->id + 36), WAVE_TYPE_SINE, 0.0f, 0.0f, 50.0f);
-    return amplitude * sound * volume;
 }
 
-const struct synth_Envelope g_envelopeBell = { 0.01f, 1.0f, 1.0f, 1.0f, 0.0f };
-
-float synth_voiceHarmonica(const struct synth_Envelope *envelope, const float volume, const float time, const struct synth_Note *note, bool *isFinished)
+void synth_appProfileClose()
 {
-    assert(envelope != NULL);
-    const float amplitude = synth_envelopeGetAmplitude(envelope, time, note->on, note->off);
-    if (amplitude <= 0.0) {
-        *isFinished = true;
-        return 0.0f;
+    synth_appProfileTick(true);
+    if (g_traceFile != NULL) {
+        fprintf(g_traceFile, "\n]}\n");
+        fclose(g_traceFile);
+        g_traceFile = NULL;
+        logi("Render trace written to %s", g_tracePath);
     }
-    const float sound =
-            + 1.00f * synth_oscillate(time, synth_scaleNote(note->id), WAVE_TYPE_SQUARE, 5.0, 0.001, 50.0f)
-            + 0.50f * synth_oscillate(time, synth_scaleNote(note->id + 12), WAVE_TYPE_SQUARE, 0.0f, 0.0f, 50.0f)
-            + 0.05f  * synth_oscillate(time, synth_scaleNote(note->id + 24), WAVE_TYPE_NOISE, 0.0f, 0.0f, 50.0f);
-    return amplitude * sound * volume;
 }
 
-const struct synth_Envelope g_envelopeHarmonica = { 0.05f, 1.0f, 0.1f, 1.0f, 0.95f };
-
 // -------------------------- +Audio --------------------------
 
-float synth_audioSampleCreate(const float time)
+// Up to AUDIO_BUFFER_SIZE frames in the device format, the readers get them as floats
+void synth_audioRender(void *output, const int frames)
 {
-    mtx_lock(&g_notesMutex);
-    float mixedOutput = 0.0;
-    for (int i = 0; i < NOTES_NUM; i++) {
-        struct synth_Note *note = g_notes[i];
-        if (note == NULL) {
-            continue;
-        }
-        bool noteFinished = false;
-        float dSound = 0;
-        switch (note->channel) {
-            case 0: dSound = synth_voiceHarmonica(&g_envelopeHarmonica, 0.5f, time, note, &noteFinished); break;
-            case 1: dSound = synth_voiceBell(&g_envelopeBell, 0.5f, time, note, &noteFinished); break;
-            default: loge("Unknown channel!"); break;
-        }
-        mixedOutput += dSound;
-        if (noteFinished && note->off > note->on) {
-            g_notes[i] = NULL;
-            free(note);
-        }
+    synth_engineRender(g_engine, g_audioBuffer, frames);
+    if (g_shmRing.header != NULL) {
+        synth_shmRingWrite(&g_shmRing, g_audioBuffer, frames);
+    }
+    if (g_profile == APP_PROFILE_GUI) {
+        synth_tapWrite(&g_tap, g_audioBuffer, frames);
+    }
+    synth_converterProcess(&g_converter, g_audioBuffer, output, frames * SYNTH_OUTPUT_CHANNELS);
+}
+
+void synth_audioAppendBuffer(const SDL_AudioDeviceID dev, float *accumulator)
+{
+    const float sampleTime = 1.0f / (float) g_deviceRate;
+    int frames = (int) (*accumulator / sampleTime);
+    if (frames > AUDIO_BUFFER_SIZE) {
+        frames = AUDIO_BUFFER_SIZE;
     }
-    mtx_unlock(&g_notesMutex);
-    return mixedOutput;
+    synth_audioRender(g_outputBytes, frames);
+    *accumulator -= frames * sampleTime;
+    SDL_ENFORCE(SDL_QueueAudio(dev, g_outputBytes, frames * SYNTH_OUTPUT_CHANNELS * synth_converterSampleSize(g_outputFormat)));
 }
 
-void synth_audioAppendBuffer(const SDL_AudioDeviceID dev, const float start, float *accumulator)
+/*
+ * With --rt the device pulls: SDL calls back on its own audio thread
+ * whenever it needs the next period, so that thread renders and gets the
+ * priority, the pinning and the prefaulted stack on its first call.
+ */
+void synth_audioCallback(void *userdata, Uint8 *stream, const int len)
 {
-    uint index = 0;
-    while (*accumulator > SAMPLE_TIME) {
-        const float time = start + index * SAMPLE_TIME;
-        g_audioBuffer[index] = synth_audioSampleCreate(time);
-        *accumulator -= SAMPLE_TIME;
-        index++;
+    (void) userdata;
+    if (!g_audioThreadEntered) {
+        synth_rtEnterThread(&g_rtConfig);
+        g_audioThreadEntered = true;
+    }
+    const int frameSize = synth_converterSampleSize(g_outputFormat) * SYNTH_OUTPUT_CHANNELS;
+    const int frames = len / frameSize;
+    for (int done = 0; done < frames; ) {
+        const int chunk = frames - done < AUDIO_BUFFER_SIZE ? frames - done : AUDIO_BUFFER_SIZE;
+        synth_audioRender(stream + done * frameSize, chunk);
+        done += chunk;
     }
-    SDL_ENFORCE(SDL_QueueAudio(dev, g_audioBuffer, index * sizeof(float)));
 }
 
 void synth_audioDeviceList()
@@ -298,30 +398,191 @@ void synth_audioDevicePrintSpec(const SDL_AudioSpec *spec)
     logi("Received samples: %d", spec->samples);
 }
 
+const char *synth_audioFormatName(const enum synth_OutputFormat format)
+{
+    switch (format) {
+        case SYNTH_OUTPUT_F32: return "f32";
+        case SYNTH_OUTPUT_S16: return "s16";
+        case SYNTH_OUTPUT_S24: return "s24";
+        case SYNTH_OUTPUT_S32: return "s32";
+    }
+    return "?";
+}
+
+// SDL has no packed 24 bits, those go out as 32
+SDL_AudioFormat synth_audioSdlFormat(const enum synth_OutputFormat format)
+{
+    switch (format) {
+        case SYNTH_OUTPUT_S16: return AUDIO_S16SYS;
+        case SYNTH_OUTPUT_S24:
+        case SYNTH_OUTPUT_S32: return AUDIO_S32SYS;
+        case SYNTH_OUTPUT_F32: return AUDIO_F32SYS;
+    }
+    return AUDIO_F32SYS;
+}
+
+bool synth_audioOutputFormat(const SDL_AudioFormat sdlFormat, enum synth_OutputFormat *format)
+{
+    switch (sdlFormat) {
+        case AUDIO_S16SYS: *format = SYNTH_OUTPUT_S16; return true;
+        case AUDIO_S32SYS: *format = SYNTH_OUTPUT_S32; return true;
+        case AUDIO_F32SYS: *format = SYNTH_OUTPUT_F32; return true;
+        default: return false;
+    }
+}
+
 void synth_audioDevicePrepare()
 {
     synth_audioDeviceList();
+    if (g_outputFormat == SYNTH_OUTPUT_S24) {
+        logw("The device takes no packed 24 bits, using s32");
+        g_outputFormat = SYNTH_OUTPUT_S32;
+    }
     SDL_AudioSpec asked, received;
     memset(&asked, 0, sizeof(asked));
     memset(&received, 0, sizeof(received));
     asked.freq = FREQUENCY;
-    asked.format = AUDIO_F32;
-    asked.channels = 1;
+    asked.format = synth_audioSdlFormat(g_outputFormat);
+    asked.channels = SYNTH_OUTPUT_CHANNELS;
     asked.samples = SAMPLES;
-    asked.callback = NULL;
-    SDL_ENFORCE(SDL_OpenAudio(&asked, &received));
+    asked.callback = g_rtConfig.enabled ? synth_audioCallback : NULL;
+    // Stereo always, the rate and with auto the format are whatever the device prefers
+    const int changes = SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | (g_formatAuto ? SDL_AUDIO_ALLOW_FORMAT_CHANGE : 0);
+    g_audioDevice = SDL_OpenAudioDevice(NULL, 0, &asked, &received, changes);
+    if (g_audioDevice == 0) {
+        SDL_FAIL();
+    }
+    if (!synth_audioOutputFormat(received.format, &g_outputFormat)) {
+        // A format the converter has no path for, SDL converts from floats then
+        logw("Device prefers format %d, falling back to f32", received.format);
+        SDL_CloseAudioDevice(g_audioDevice);
+        asked.format = AUDIO_F32SYS;
+        g_audioDevice = SDL_OpenAudioDevice(NULL, 0, &asked, &received, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+        if (g_audioDevice == 0) {
+            SDL_FAIL();
+        }
+        g_outputFormat = SYNTH_OUTPUT_F32;
+    }
     logi("Asked:")
     synth_audioDevicePrintSpec(&asked);
     logi("Received:")
     synth_audioDevicePrintSpec(&received);
+    g_deviceRate = received.freq;
+}
+
+// -------------------------- +View --------------------------
+
+void synth_viewCreate()
+{
+    synth_tapInit(&g_tap);
+    if (!synth_fftCreate(&g_fft, SYNTH_TAP_FRAMES)) {
+        loge("Cannot create the spectrum!");
+    }
+    for (int i = 0; i < SYNTH_TAP_FRAMES; i++) {
+        g_viewWindow[i] = 0.5f - 0.5f * cosf(2.0f * (float) M_PI * (float) i / (float) SYNTH_TAP_FRAMES);
+    }
+}
+
+void synth_viewDestroy()
+{
+    synth_fftDestroy(&g_fft);
+}
+
+// One channel of the snapshot squeezed into a lane of the scope
+void synth_viewDrawScope(const int channel, const int top, const int height)
+{
+    const float middle = (float) top + (float) height * 0.5f;
+    for (int x = 0; x < VIEW_WIDTH; x++) {
+        const int frame = x * SYNTH_TAP_FRAMES / VIEW_WIDTH;
+        float value = g_viewFrames[frame * SYNTH_OUTPUT_CHANNELS + channel];
+        value = value > 1.0f ? 1.0f : value < -1.0f ? -1.0f : value;
+        g_viewPoints[x] = (SDL_Point) { x, (int) (middle - value * (float) height * 0.5f) };
+    }
+    SDL_ENFORCE(SDL_RenderDrawLines(g_renderer, g_viewPoints, VIEW_WIDTH));
+}
+
+/*
+ * Hann windowed mono mix of the snapshot. A full scale sine peaks at a
+ * quarter of the size with this window, which is 0 dB here. Columns are
+ * spaced logarithmically from VIEW_MIN_FREQ to Nyquist and show the
+ * loudest bin they cover, so the top octave does not alias into a comb.
+ */
+void synth_viewDrawSpectrum(const int top, const int height)
+{
+    for (int i = 0; i < SYNTH_TAP_FRAMES; i++) {
+        const float *frame = g_viewFrames + i * SYNTH_OUTPUT_CHANNELS;
+        g_viewMono[i] = 0.5f * (frame[0] + frame[1]) * g_viewWindow[i];
+    }
+    synth_fftReal(&g_fft, g_viewMono, g_viewRe, g_viewIm);
+    const float scale = 4.0f / (float) SYNTH_TAP_FRAMES;
+    for (int k = 0; k < VIEW_BINS; k++) {
+        const float power = (g_viewRe[k] * g_viewRe[k] + g_viewIm[k] * g_viewIm[k]) * scale * scale;
+        g_viewDb[k] = 10.0f * log10f(power + 1e-12f);
+    }
+    const float nyquist = 0.5f * (float) g_deviceRate;
+    const float binsPerHertz = (float) SYNTH_TAP_FRAMES / (float) g_deviceRate;
+    const float span = logf(nyquist / VIEW_MIN_FREQ);
+    int bin = (int) (VIEW_MIN_FREQ * binsPerHertz);
+    for (int x = 0; x < VIEW_WIDTH; x++) {
+        const float freq = VIEW_MIN_FREQ * expf(span * (float) (x + 1) / (float) VIEW_WIDTH);
+        int last = (int) (freq * binsPerHertz);
+        last = last >= VIEW_BINS ? VIEW_BINS - 1 : last;
+        float db = g_viewDb[bin];
+        for (int k = bin + 1; k <= last; k++) {
+            db = g_viewDb[k] > db ? g_viewDb[k] : db;
+        }
+        bin = last > bin ? last : bin;
+        float level = db / VIEW_FLOOR_DB;
+        level = level < 0.0f ? 0.0f : level > 1.0f ? 1.0f : level;
+        g_viewPoints[x] = (SDL_Point) { x, top + (int) (level * (float) (height - 1)) };
+    }
+    SDL_ENFORCE(SDL_RenderDrawLines(g_renderer, g_viewPoints, VIEW_WIDTH));
+}
+
+// UI thread, once per tick, the audio side only copies into the tap
+void synth_viewDraw()
+{
+    const float *fresh = synth_tapRead(&g_tap);
+    if (fresh != NULL) {
+        g_viewFrames = fresh;
+        for (int i = 0; i < SYNTH_TAP_FRAMES * SYNTH_OUTPUT_CHANNELS; i++) {
+            if (fabsf(fresh[i]) >= 1.0f) {
+                g_viewClipHold = VIEW_CLIP_HOLD;
+                break;
+            }
+        }
+    }
+    SDL_ENFORCE(SDL_SetRenderDrawColor(g_renderer, 16, 16, 16, 255));
+    SDL_ENFORCE(SDL_RenderClear(g_renderer));
+    if (g_viewFrames != NULL) {
+        const int lane = VIEW_HEIGHT / 4;
+        SDL_ENFORCE(SDL_SetRenderDrawColor(g_renderer, 255, 255, 0, 255));
+        synth_viewDrawScope(0, 0, lane);
+        synth_viewDrawScope(1, lane, lane);
+        SDL_ENFORCE(SDL_SetRenderDrawColor(g_renderer, 0, 200, 255, 255));
+        synth_viewDrawSpectrum(2 * lane, VIEW_HEIGHT - 2 * lane);
+    }
+    if (g_viewClipHold > 0) {
+        g_viewClipHold--;
+        const SDL_Rect border = { 0, 0, VIEW_WIDTH, VIEW_HEIGHT };
+        SDL_ENFORCE(SDL_SetRenderDrawColor(g_renderer, 255, 0, 0, 255));
+        SDL_ENFORCE(SDL_RenderDrawRect(g_renderer, &border));
+    }
+    SDL_RenderPresent(g_renderer);
 }
 
 // -------------------------- +Application --------------------------
 
+// Only the subsystems of the profile, device scans of the others are skipped
+void synth_appSdlInit()
+{
+    const Uint32 flags = g_profile == APP_PROFILE_GUI ? SDL_INIT_VIDEO | SDL_INIT_AUDIO : SDL_INIT_AUDIO;
+    SDL_ENFORCE(SDL_Init(flags));
+}
+
 void synth_appWinCreate()
 {
-    SDL_ENFORCE(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_GAMECONTROLLER));
-    g_window = SDL_CreateWindow( "SDL Synth", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 300, 200, SDL_WINDOW_SHOWN);
+    g_window = SDL_CreateWindow( "SDL Synth", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, VIEW_WIDTH, VIEW_HEIGHT, SDL_WINDOW_SHOWN);
     SDL_ENFORCE_PTR(g_window);
     g_renderer = SDL_CreateRenderer(g_window, -1, 0);
     SDL_ENFORCE_PTR(g_window);
@@ -330,7 +591,40 @@ void synth_appWinCreate()
     SDL_RenderPresent(g_renderer);
 }
 
-void synth_appHandleKey(const SDL_Keycode keysym, const bool pressed, const float time)
+void synth_appEngineCreate()
+{
+    struct synth_EngineConfig config;
+    synth_engineConfigDefault(&config);
+    config.sampleRate = g_internalRate;
+    config.outputRate = g_deviceRate;
+    config.resamplerQuality = g_resamplerQuality;
+    config.maxFrames = SAMPLES;
+    config.oversampling = g_oversampling;
+    g_engine = synth_engineCreate(&config);
+    if (g_engine == NULL) {
+        loge("Cannot create the engine!");
+    }
+    if (g_internalRate != g_deviceRate) {
+        logi("Engine renders at %d Hz, resampled to %d Hz", g_internalRate, g_deviceRate);
+    }
+    for (int part = 0; part <= 1; part++) {
+        synth_engineSetPartMode(g_engine, part, g_voiceMode);
+        if (!synth_engineSetPartUnison(g_engine, part, g_unison)) {
+            logw("Unison goes from 1 to %d", SYNTH_UNISON_MAX);
+        }
+        synth_engineSetParam(g_engine, part, SYNTH_PARAM_GLIDE, g_glide);
+    }
+}
+
+void synth_appSampleLoad()
+{
+    const int sample = synth_engineLoadSample(g_engine, g_samplePath);
+    if (sample >= 0) {
+        synth_engineSetPartSample(g_engine, 1, sample);
+    }
+}
+
+void synth_appHandleKey(const SDL_Keycode keysym, const bool pressed)
 {
     for (int k = 0; k < KEYS_NUM; k++)
     {
@@ -338,42 +632,16 @@ void synth_appHandleKey(const SDL_Keycode keysym, const bool pressed, const floa
         if (keysym != key) {
             continue;
         }
-        mtx_lock(&g_notesMutex);
-        struct synth_Note *note = NULL;
-        for (int i = 0; i < NOTES_NUM; ++i) {
-            if (g_notes[i] != NULL && g_notes[i]->id == k) {
-                note = g_notes[i];
-                break;
-            }
-        }
-        if (note == NULL) {
-            if (pressed) {
-                for (int i = 0; i < NOTES_NUM; i++) {
-                    if (g_notes[i] == NULL) {
-                        g_notes[i] = malloc(sizeof(struct synth_Note));
-                        g_notes[i]->id = k;
-                        g_notes[i]->on = time;
-                        g_notes[i]->channel = g_leftShift ? 0 : 1;
-                        break;
-                    }
-                }
-            }
+        if (pressed) {
+            g_keyParts[k] = g_leftShift ? 0 : 1;
+            synth_engineNoteOn(g_engine, g_keyParts[k], k);
         } else {
-            if (pressed) {
-                if (note->off > note->on) {
-                    note->on = time;
-                }
-            } else {
-                if (note->off < note->on) {
-                    note->off = time;
-                }
-            }
+            synth_engineNoteOff(g_engine, g_keyParts[k], k);
         }
-        mtx_unlock(&g_notesMutex);
     }
 }
 
-void synth_appPollEvents(const float time)
+void synth_appPollEvents()
 {
     SDL_Event event;
     while( SDL_PollEvent(&event) != 0 ) {
@@ -382,22 +650,13 @@ void synth_appPollEvents(const float time)
         } else if (event.key.keysym.sym == SDLK_LSHIFT) {
             g_leftShift = event.type == SDL_KEYDOWN;
         } else if (event.type == SDL_KEYDOWN) {
-            synth_appHandleKey(event.key.keysym.sym, true, time);
+            synth_appHandleKey(event.key.keysym.sym, true);
         } else if (event.type == SDL_KEYUP) {
-            synth_appHandleKey(event.key.keysym.sym, false, time);
+            synth_appHandleKey(event.key.keysym.sym, false);
         }
     }
 }
 
-void synth_appSleepIfNeeded(const float start)
-{
-    const float finish = synth_appGetTime();
-    const float sleep = TICK_TIME - (finish - start);
-    if (sleep > 0) {
-        synth_appSleep(sleep);
-    }
-}
-
 void synth_appRunLoop()
 {
     logi("synth_appRunLoop() called");
@@ -405,15 +664,337 @@ void synth_appRunLoop()
     float last = synth_appGetTime();
     while (!g_quit) {
         const float start = synth_appGetTime();
-        synth_appPollEvents(start);
+        if (g_profile == APP_PROFILE_GUI) {
+            synth_appPollEvents();
+            synth_viewDraw();
+        }
         const float elapsed = start - last;
         accumulator += elapsed;
-        synth_audioAppendBuffer(AUDIO_DEV_ID, last, &accumulator);
+        synth_audioAppendBuffer(g_audioDevice, &accumulator);
+        synth_appProfileTick(false);
         last = start;
         synth_appSleepIfNeeded(start);
     }
 }
 
+// The device callback renders, this thread only draws and reads the keys
+void synth_appRunLoopRealtime()
+{
+    logi("synth_appRunLoopRealtime() called");
+    while (!g_quit) {
+        const float start = synth_appGetTime();
+        if (g_profile == APP_PROFILE_GUI) {
+            synth_appPollEvents();
+            synth_viewDraw();
+        }
+        synth_appProfileTick(false);
+        synth_appSleepIfNeeded(start);
+    }
+}
+
+// -------------------------- +Script --------------------------
+
+/*
+ * One event per line, frames at the internal rate as in synth_engineGetFrame,
+ * values as in the control protocol. Lines may come in any order, events
+ * on the same frame keep theirs. Empty lines and # comments are skipped.
+ *
+ *     # frame  type   part  index  [value  [length]]
+ *     0        on     0     40
+ *     44100    off    0     40
+ *     22050    param  0     0      0.5
+ *     88200    ramp   0     0      1.0    44100
+ */
+int synth_appScriptCompare(const void *left, const void *right)
+{
+    const struct synth_AppScriptLine *a = left;
+    const struct synth_AppScriptLine *b = right;
+    if (a->record.frame != b->record.frame) {
+        return a->record.frame < b->record.frame ? -1 : 1;
+    }
+    return a->order - b->order;
+}
+
+bool synth_appScriptParse(const char *text, struct synth_ControlRecord *record)
+{
+    char type[16];
+    unsigned long long frame;
+    unsigned part, index, length = 0;
+    float value = 0.0f;
+    const int fields = sscanf(text, "%llu %15s %u %u %f %u", &frame, type, &part, &index, &value, &length);
+    memset(record, 0, sizeof(struct synth_ControlRecord));
+    if (fields < 4 || part >= SYNTH_PARTS_NUM) {
+        return false;
+    }
+    record->part = (uint8_t) part;
+    record->index = (uint16_t) index;
+    record->value = value;
+    record->frame = frame;
+    record->length = length;
+    if (strcmp(type, "on") == 0 && fields == 4) {
+        record->type = SYNTH_CONTROL_NOTE_ON;
+    } else if (strcmp(type, "off") == 0 && fields == 4) {
+        record->type = SYNTH_CONTROL_NOTE_OFF;
+    } else if (strcmp(type, "param") == 0 && fields == 5) {
+        record->type = SYNTH_CONTROL_AUTOMATE;
+    } else if (strcmp(type, "ramp") == 0 && fields == 6) {
+        record->type = SYNTH_CONTROL_AUTOMATE;
+    } else {
+        return false;
+    }
+    if (record->type == SYNTH_CONTROL_AUTOMATE) {
+        return record->index < SYNTH_PARAMS_NUM;
+    }
+    return record->index <= SYNTH_NOTE_MAX;
+}
+
+bool synth_appScriptLoad()
+{
+    FILE *file = fopen(g_scriptPath, "r");
+    if (file == NULL) {
+        loge("Cannot open %s", g_scriptPath);
+        return false;
+    }
+    int capacity = 0;
+    int line = 0;
+    char text[256];
+    while (fgets(text, sizeof(text), file) != NULL) {
+        line++;
+        const char *start = text + strspn(text, " \t");
+        if (*start == '#' || *start == '\n' || *start == '\r' || *start == '\0') {
+            continue;
+        }
+        if (g_scriptNum == capacity) {
+            capacity = capacity == 0 ? 256 : capacity * 2;
+            struct synth_AppScriptLine *grown = realloc(g_script, capacity * sizeof(struct synth_AppScriptLine));
+            if (grown == NULL) {
+                logw("Out of memory at line %d of %s", line, g_scriptPath);
+                fclose(file);
+                return false;
+            }
+            g_script = grown;
+        }
+        struct synth_AppScriptLine *next = &g_script[g_scriptNum];
+        if (!synth_appScriptParse(start, &next->record)) {
+            logw("Skipping line %d of %s", line, g_scriptPath);
+            continue;
+        }
+        next->order = g_scriptNum++;
+    }
+    fclose(file);
+    qsort(g_script, g_scriptNum, sizeof(struct synth_AppScriptLine), synth_appScriptCompare);
+    logi("Script %s has %d events", g_scriptPath, g_scriptNum);
+    return true;
+}
+
+// Queues the events before the given frame, the rest when the engine has room again
+void synth_appScriptFeed(const uint64_t until)
+{
+    for (; g_scriptNext < g_scriptNum && g_script[g_scriptNext].record.frame < until; g_scriptNext++) {
+        const struct synth_ControlRecord *record = &g_script[g_scriptNext].record;
+        bool queued = false;
+        switch (record->type) {
+            case SYNTH_CONTROL_NOTE_ON:
+                queued = synth_engineNoteOnAt(g_engine, record->part, record->index, record->frame);
+                break;
+            case SYNTH_CONTROL_NOTE_OFF:
+                queued = synth_engineNoteOffAt(g_engine, record->part, record->index, record->frame);
+                break;
+            default:
+                queued = synth_engineAutomateParam(g_engine, record->part, record->index, record->value, record->frame, (int) record->length);
+                break;
+        }
+        if (!queued) {
+            return;
+        }
+    }
+}
+
+// -------------------------- +Offline --------------------------
+
+// Integer PCM or IEEE float, formats other than PCM need the cbSize field and a fact chunk
+void synth_appWavHeader(FILE *file, const int rate, const int channels, const uint32_t frames, const enum synth_OutputFormat sampleFormat)
+{
+    const bool pcm = sampleFormat != SYNTH_OUTPUT_F32;
+    const uint32_t sampleSize = (uint32_t) synth_converterSampleSize(sampleFormat);
+    const uint32_t dataSize = frames * channels * sampleSize;
+    const uint32_t fmtSize = pcm ? 16 : 18;
+    const uint32_t factSize = 4;
+    const uint32_t riffSize = 4 + 8 + fmtSize + (pcm ? 0 : 8 + factSize) + 8 + dataSize;
+    const uint16_t format = pcm ? 1 : 3;
+    const uint16_t channels16 = (uint16_t) channels;
+    const uint32_t rate32 = (uint32_t) rate;
+    const uint32_t byteRate = rate32 * channels * sampleSize;
+    const uint16_t blockAlign = (uint16_t) (channels * sampleSize);
+    const uint16_t bits = (uint16_t) (sampleSize * 8);
+    const uint16_t extraSize = 0;
+    fwrite("RIFF", 1, 4, file);
+    fwrite(&riffSize, 4, 1, file);
+    fwrite("WAVEfmt ", 1, 8, file);
+    fwrite(&fmtSize, 4, 1, file);
+    fwrite(&format, 2, 1, file);
+    fwrite(&channels16, 2, 1, file);
+    fwrite(&rate32, 4, 1, file);
+    fwrite(&byteRate, 4, 1, file);
+    fwrite(&blockAlign, 2, 1, file);
+    fwrite(&bits, 2, 1, file);
+    if (!pcm) {
+        fwrite(&extraSize, 2, 1, file);
+        fwrite("fact", 1, 4, file);
+        fwrite(&factSize, 4, 1, file);
+        fwrite(&frames, 4, 1, file);
+    }
+    fwrite("data", 1, 4, file);
+    fwrite(&dataSize, 4, 1, file);
+}
+
+/*
+ * Renders as fast as the engine goes, so the input has to be there before
+ * it starts. The script is queued a little ahead of the render. A control
+ * client gets the render started with its first batch: everything in it
+ * lands on its frame, later batches play when they arrive.
+ *
+ * The file runs for the given seconds or up to the last event of the
+ * script, whichever is later, within the 4 GB of a WAV file. Stamped
+ * events past the end are dropped and counted.
+ */
+void synth_appRunOffline()
+{
+    if (g_scriptPath != NULL && !synth_appScriptLoad()) {
+        return;
+    }
+    FILE *file = fopen(g_offlinePath, "wb");
+    if (file == NULL) {
+        loge("Cannot open %s", g_offlinePath);
+        return;
+    }
+    uint64_t length = (uint64_t) (g_offlineSeconds * (float) g_deviceRate);
+    if (g_scriptNum > 0) {
+        const uint64_t last = g_script[g_scriptNum - 1].record.frame * g_deviceRate / g_internalRate + 1;
+        length = last > length ? last : length;
+    }
+    const uint64_t limit = (UINT32_MAX - WAV_HEADER_MAX) / (uint32_t) (synth_converterSampleSize(g_outputFormat) * SYNTH_OUTPUT_CHANNELS);
+    if (length > limit) {
+        logw("%s would outgrow a WAV file, it ends after %llu frames", g_offlinePath, (unsigned long long) limit);
+        length = limit;
+    }
+    const uint32_t total = (uint32_t) length;
+    if (g_controlled) {
+        logi("Waiting for the first control batch on %s", g_controlPath);
+        while (atomic_load(&g_control.received) == 0 && !g_quit) {
+            synth_appSleep(0.001f);
+        }
+    }
+    synth_appWavHeader(file, g_deviceRate, SYNTH_OUTPUT_CHANNELS, total, g_outputFormat);
+    uint32_t done = 0;
+    while (done < total && !g_quit) {
+        const int frames = total - done < SAMPLES ? (int) (total - done) : SAMPLES;
+        synth_appScriptFeed(synth_engineGetFrame(g_engine) + SCRIPT_AHEAD);
+        synth_engineRender(g_engine, g_audioBuffer, frames);
+        if (g_shmRing.header != NULL) {
+            synth_shmRingWrite(&g_shmRing, g_audioBuffer, frames);
+        }
+        synth_converterProcess(&g_converter, g_audioBuffer, g_outputBytes, frames * SYNTH_OUTPUT_CHANNELS);
+        fwrite(g_outputBytes, synth_converterSampleSize(g_outputFormat) * SYNTH_OUTPUT_CHANNELS, frames, file);
+        synth_appProfileTick(false);
+        done += frames;
+    }
+    struct synth_EngineStats stats;
+    synth_engineGetStats(g_engine, &stats);
+    const int dropped = stats.scheduled + g_scriptNum - g_scriptNext;
+    if (dropped > 0) {
+        logw("%d stamped events past the end were dropped", dropped);
+    }
+    if (done < total) {
+        fseek(file, 0, SEEK_SET);
+        synth_appWavHeader(file, g_deviceRate, SYNTH_OUTPUT_CHANNELS, done, g_outputFormat);
+    }
+    fclose(file);
+    logi("Rendered %u frames of %s to %s", done, synth_audioFormatName(g_outputFormat), g_offlinePath);
+}
+
+void synth_appHandleSignal(const int signal)
+{
+    (void) signal;
+    g_quit = true;
+}
+
+void synth_appParseArgs(const int argc, char **argv)
+{
+    synth_rtConfigDefault(&g_rtConfig);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rt") == 0) {
+            g_rtConfig.enabled = true;
+        } else if (strncmp(argv[i], "--rt-cpu=", 9) == 0) {
+            g_rtConfig.cpu = atoi(argv[i] + 9);
+        } else if (strncmp(argv[i], "--rt-priority=", 14) == 0) {
+            g_rtConfig.priority = atoi(argv[i] + 14);
+        } else if (strncmp(argv[i], "--oversampling=", 15) == 0) {
+            g_oversampling = atoi(argv[i] + 15);
+        } else if (strncmp(argv[i], "--rate=", 7) == 0) {
+            g_internalRate = atoi(argv[i] + 7);
+        } else if (strncmp(argv[i], "--control=", 10) == 0) {
+            g_controlPath = argv[i] + 10;
+        } else if (strcmp(argv[i], "--profile=gui") == 0) {
+            g_profile = APP_PROFILE_GUI;
+        } else if (strcmp(argv[i], "--profile=audio") == 0) {
+            g_profile = APP_PROFILE_AUDIO;
+        } else if (strcmp(argv[i], "--profile=offline") == 0) {
+            g_profile = APP_PROFILE_OFFLINE;
+        } else if (strncmp(argv[i], "--output=", 9) == 0) {
+            g_offlinePath = argv[i] + 9;
+        } else if (strncmp(argv[i], "--script=", 9) == 0) {
+            g_scriptPath = argv[i] + 9;
+        } else if (strncmp(argv[i], "--seconds=", 10) == 0) {
+            g_offlineSeconds = (float) atof(argv[i] + 10);
+        } else if (strcmp(argv[i], "--mode=poly") == 0) {
+            g_voiceMode = SYNTH_VOICE_MODE_POLY;
+        } else if (strcmp(argv[i], "--mode=mono") == 0) {
+            g_voiceMode = SYNTH_VOICE_MODE_MONO;
+        } else if (strcmp(argv[i], "--mode=legato") == 0) {
+            g_voiceMode = SYNTH_VOICE_MODE_LEGATO;
+        } else if (strncmp(argv[i], "--unison=", 9) == 0) {
+            g_unison = atoi(argv[i] + 9);
+        } else if (strncmp(argv[i], "--glide=", 8) == 0) {
+            g_glide = (float) atof(argv[i] + 8);
+        } else if (strcmp(argv[i], "--format=auto") == 0) {
+            g_formatAuto = true;
+        } else if (strcmp(argv[i], "--format=f32") == 0) {
+            g_formatAuto = false;
+            g_outputFormat = SYNTH_OUTPUT_F32;
+        } else if (strcmp(argv[i], "--format=s16") == 0) {
+            g_formatAuto = false;
+            g_outputFormat = SYNTH_OUTPUT_S16;
+        } else if (strcmp(argv[i], "--format=s24") == 0) {
+            g_formatAuto = false;
+            g_outputFormat = SYNTH_OUTPUT_S24;
+        } else if (strcmp(argv[i], "--format=s32") == 0) {
+            g_formatAuto = false;
+            g_outputFormat = SYNTH_OUTPUT_S32;
+        } else if (strcmp(argv[i], "--dither") == 0) {
+            g_dither = true;
+        } else if (strcmp(argv[i], "--no-dither") == 0) {
+            g_dither = false;
+        } else if (strncmp(argv[i], "--stats=", 8) == 0) {
+            g_profileInterval = (float) atof(argv[i] + 8);
+        } else if (strncmp(argv[i], "--trace=", 8) == 0) {
+            g_tracePath = argv[i] + 8;
+        } else if (strncmp(argv[i], "--shm=", 6) == 0) {
+            g_shmName = argv[i] + 6;
+        } else if (strncmp(argv[i], "--sample=", 9) == 0) {
+            g_samplePath = argv[i] + 9;
+        } else if (strcmp(argv[i], "--resampler=fast") == 0) {
+            g_resamplerQuality = SYNTH_RESAMPLER_FAST;
+        } else if (strcmp(argv[i], "--resampler=medium") == 0) {
+            g_resamplerQuality = SYNTH_RESAMPLER_MEDIUM;
+        } else if (strcmp(argv[i], "--resampler=best") == 0) {
+            g_resamplerQuality = SYNTH_RESAMPLER_BEST;
+        } else {
+            logi("Unknown argument: %s", argv[i]);
+        }
+    }
+}
+
 void synth_appPringKeysLayout()
 {
     logi("|   |   |   |   |   | |   |   |   |   | |   | |   |   |   |");
@@ -426,16 +1007,72 @@ void synth_appPringKeysLayout()
 
 // -------------------------- +Main --------------------------
 
-int main()
-{
-    synth_createNotesMutex();
-    synth_appWinCreate();
-    synth_audioDevicePrepare();
-    synth_appPringKeysLayout();
-    SDL_PauseAudio(0);
-    synth_appRunLoop();
-    SDL_CloseAudio();
-    SDL_Quit();
-    synth_destroyNotesMutex();
+int main(int argc, char **argv)
+{
+    g_startupMark = synth_appGetClock();
+    synth_logStart();
+    synth_appParseArgs(argc, argv);
+    signal(SIGINT, synth_appHandleSignal);
+    signal(SIGTERM, synth_appHandleSignal);
+    synth_appStartupMark("arguments");
+    if (g_profile != APP_PROFILE_OFFLINE) {
+        synth_appSdlInit();
+        synth_appStartupMark("sdl");
+    }
+    if (g_profile == APP_PROFILE_GUI) {
+        synth_appWinCreate();
+        synth_viewCreate();
+        synth_appStartupMark("window");
+    }
+    if (g_profile != APP_PROFILE_OFFLINE) {
+        synth_audioDevicePrepare();
+        synth_appStartupMark("audio");
+    } else if (g_formatAuto) {
+        g_outputFormat = SYNTH_OUTPUT_S16;
+    }
+    synth_converterInit(&g_converter, g_outputFormat, g_dither);
+    synth_appEngineCreate();
+    synth_appStartupMark("engine");
+    if (g_rtConfig.enabled) {
+        synth_rtLockMemory();
+        synth_appStartupMark("mlockall");
+    }
+    if (g_samplePath != NULL) {
+        synth_appSampleLoad();
+        synth_appStartupMark("sample");
+    }
+    g_controlled = g_controlPath != NULL && synth_controlCreate(&g_control, g_engine, g_controlPath);
+    if (g_shmName != NULL) {
+        synth_shmRingCreate(&g_shmRing, g_shmName, g_deviceRate, SYNTH_OUTPUT_CHANNELS, SHM_FRAMES);
+    }
+    if (g_profileInterval > 0.0f || g_tracePath != NULL) {
+        synth_appProfileOpen();
+    }
+    synth_appStartupMark("outputs");
+    synth_appStartupReport();
+    if (g_profile == APP_PROFILE_OFFLINE) {
+        synth_appRunOffline();
+    } else {
+        if (g_profile == APP_PROFILE_GUI) {
+            synth_appPringKeysLayout();
+        }
+        SDL_PauseAudioDevice(g_audioDevice, 0);
+        if (g_rtConfig.enabled) {
+            synth_appRunLoopRealtime();
+        } else {
+            synth_appRunLoop();
+        }
+        SDL_CloseAudioDevice(g_audioDevice);
+        SDL_Quit();
+    }
+    synth_appProfileClose();
+    if (g_controlled) {
+        synth_controlDestroy(&g_control);
+    }
+    free(g_script);
+    synth_shmRingDestroy(&g_shmRing);
+    synth_viewDestroy();
+    synth_engineDestroy(g_engine);
+    synth_logStop();
     return 0;
 }
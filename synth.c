@@ -0,0 +1,1224 @@
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "synth.h"
+#include "synth_log.h"
+#include "synth_oversampler.h"
+#include "synth_profile.h"
+#include "synth_resampler.h"
+#include "synth_sample.h"
+#include "synth_voices.h"
+
+// -------------------------- +Const --------------------------
+
+#define       PI                    ((float) M_PI)
+
+#define       EVENTS_MASK           (SYNTH_EVENTS_NUM - 1)
+
+#define       DEFAULT_SAMPLE_RATE   44100
+#define       DEFAULT_VOICES_NUM    64
+#define       DEFAULT_MAX_FRAMES    512
+#define       DEFAULT_OVERSAMPLING  1
+
+#define       BUFFER_ALIGN          64
+#define       BUFFER_ALIGN_FLOATS   (BUFFER_ALIGN / (int) sizeof(float))
+
+// Voices ask for the next frames to be prefetched every half of the prefetched window
+#define       SAMPLE_REQUEST_STRIDE (SAMPLE_PREFETCH_FRAMES / 2)
+
+// Live parameter changes glide over this many seconds
+#define       SMOOTH_TIME           0.01f
+
+// Notes a mono part remembers to fall back to, the oldest ones are forgotten
+#define       HELD_NOTES_NUM        16
+
+#define       LOAD_RELEASE          0.05f
+#define       LOAD_HYSTERESIS       0.8f
+
+#if SYNTH_PROFILE
+#define       ENGINE_PROFILE(engine) (&(engine)->profile.block)
+#endif
+
+// -------------------------- +Events --------------------------
+
+enum synth_EventType
+{
+    EVENT_TYPE_NOTE_ON,
+    EVENT_TYPE_NOTE_OFF,
+    EVENT_TYPE_PART_PATCH,
+    EVENT_TYPE_PART_VOLUME,
+    EVENT_TYPE_PART_PAN,
+    EVENT_TYPE_PART_VOICES,
+    EVENT_TYPE_PART_OVERSAMPLING,
+    EVENT_TYPE_PART_SAMPLE,
+    EVENT_TYPE_PART_MODE,
+    EVENT_TYPE_PART_UNISON,
+    EVENT_TYPE_PARAM
+};
+
+// Events stamped with a frame wait for it, 0 is as soon as possible
+struct synth_Event
+{
+    enum synth_EventType type;
+    int part;
+    int note;       // or the parameter
+    float value;
+    uint64_t frame;
+    int length;     // frames of a parameter ramp
+    bool scheduled; // holds one of the SYNTH_EVENTS_NUM slots for later frames
+};
+
+struct synth_EventCell
+{
+    atomic_size_t sequence;
+    struct synth_Event event;
+};
+
+/*
+ * Bounded multi-producer / single-consumer queue: every cell carries a
+ * sequence number telling producers and the consumer whose turn it is.
+ */
+struct synth_EventQueue
+{
+    struct synth_EventCell cells[SYNTH_EVENTS_NUM];
+    atomic_size_t head;
+    atomic_size_t tail;
+};
+
+void synth_eventQueueInit(struct synth_EventQueue *queue)
+{
+    for (size_t i = 0; i < SYNTH_EVENTS_NUM; i++) {
+        atomic_init(&queue->cells[i].sequence, i);
+    }
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+}
+
+bool synth_eventQueuePush(struct synth_EventQueue *queue, const struct synth_Event *event)
+{
+    size_t pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    struct synth_EventCell *cell;
+    for (;;) {
+        cell = &queue->cells[pos & EVENTS_MASK];
+        const size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        const intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&queue->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        }
+    }
+    cell->event = *event;
+    atomic_store_explicit(&cell->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+bool synth_eventQueuePop(struct synth_EventQueue *queue, struct synth_Event *event)
+{
+    const size_t pos = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    struct synth_EventCell *cell = &queue->cells[pos & EVENTS_MASK];
+    const size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    if (sequence != pos + 1) {
+        return false;
+    }
+    *event = cell->event;
+    atomic_store_explicit(&cell->sequence, pos + SYNTH_EVENTS_NUM, memory_order_release);
+    atomic_store_explicit(&queue->head, pos + 1, memory_order_relaxed);
+    return true;
+}
+
+// -------------------------- +Params --------------------------
+
+_Static_assert(SYNTH_PARAM_GAIN_2 - SYNTH_PARAM_GAIN_0 + 1 == PARTIALS_NUM, "Every partial has its parameters");
+
+struct synth_ParamRange
+{
+    float min;
+    float max;
+};
+
+const struct synth_ParamRange g_paramRanges[SYNTH_PARAMS_NUM] =
+{
+    [SYNTH_PARAM_VOLUME]      = { 0.0f,  4.0f },
+    [SYNTH_PARAM_PAN]         = { -1.0f, 1.0f },
+    [SYNTH_PARAM_ATTACK]      = { 0.0f,  60.0f },
+    [SYNTH_PARAM_DECAY]       = { 0.0f,  60.0f },
+    [SYNTH_PARAM_RELEASE]     = { 0.0f,  60.0f },
+    [SYNTH_PARAM_START]       = { 0.0f,  1.0f },
+    [SYNTH_PARAM_SUSTAIN]     = { 0.0f,  1.0f },
+    [SYNTH_PARAM_GAIN_0]      = { 0.0f,  4.0f },
+    [SYNTH_PARAM_GAIN_1]      = { 0.0f,  4.0f },
+    [SYNTH_PARAM_GAIN_2]      = { 0.0f,  4.0f },
+    [SYNTH_PARAM_LFO_FREQ_0]  = { 0.0f,  100.0f },
+    [SYNTH_PARAM_LFO_FREQ_1]  = { 0.0f,  100.0f },
+    [SYNTH_PARAM_LFO_FREQ_2]  = { 0.0f,  100.0f },
+    [SYNTH_PARAM_LFO_DEPTH_0] = { 0.0f,  1.0f },
+    [SYNTH_PARAM_LFO_DEPTH_1] = { 0.0f,  1.0f },
+    [SYNTH_PARAM_LFO_DEPTH_2] = { 0.0f,  1.0f },
+    [SYNTH_PARAM_GLIDE]       = { 0.0f,  10.0f },
+    [SYNTH_PARAM_DETUNE]      = { 0.0f,  100.0f },
+    [SYNTH_PARAM_SPREAD]      = { 0.0f,  1.0f }
+};
+
+float synth_paramClamp(const enum synth_Param param, const float value)
+{
+    return fminf(fmaxf(value, g_paramRanges[param].min), g_paramRanges[param].max);
+}
+
+// Linear ramp to the target, advanced once per sub-block
+struct synth_ParamRamp
+{
+    float value;
+    float target;
+    float step;
+    int remaining;
+    bool moved;
+};
+
+// A ramp over no frames jumps
+void synth_paramRampStart(struct synth_ParamRamp *ramp, const float target, const int frames)
+{
+    ramp->target = target;
+    ramp->remaining = frames > 0 ? frames : 0;
+    ramp->step = frames > 0 ? (target - ramp->value) / (float) frames : 0.0f;
+    if (frames <= 0) {
+        ramp->value = target;
+    }
+    ramp->moved = true;
+}
+
+// Returns true when the value has moved since the last call
+bool synth_paramRampAdvance(struct synth_ParamRamp *ramp, const int frames)
+{
+    if (frames > 0 && ramp->remaining > 0) {
+        if (frames >= ramp->remaining) {
+            ramp->value = ramp->target;
+            ramp->remaining = 0;
+        } else {
+            ramp->value += ramp->step * (float) frames;
+            ramp->remaining -= frames;
+        }
+        ramp->moved = true;
+    }
+    const bool moved = ramp->moved;
+    ramp->moved = false;
+    return moved;
+}
+
+// -------------------------- +Parts --------------------------
+
+struct synth_Part
+{
+    struct synth_Patch patch;
+    float volume;
+    float pan;
+    float gainLeft;
+    float gainRight;
+    float fromLeft;     // gains at the start of the sub-block, the mix ramps from them
+    float fromRight;
+    struct synth_ParamRamp params[SYNTH_PARAMS_NUM];
+    int voicesBudget;
+    int sample;
+    float sampleRate;
+    enum synth_VoiceMode mode;
+    float glide;
+    float detune;
+    float spread;
+    int held[HELD_NOTES_NUM];   // mono modes, the last one sounds
+    int heldNum;
+    int monoNote;       // note of the mono voice or -1
+    uint32_t monoAge;   // the mono voice, releasing voices may play its note too
+    int lastNote;       // glides start from here, -1 before the first note
+    struct synth_Voices voices;
+    struct synth_Oversampler oversampler;
+    struct synth_Oversampler sideOversampler;
+    float *buffer;
+    float *side;        // side of unison stacks, the buffer holds the mid
+    bool stereo;
+};
+
+// Constant power panning, pan goes from -1 (left) to +1 (right)
+void synth_partUpdateGains(struct synth_Part *part)
+{
+    const float angle = (part->pan + 1.0f) * (PI / 4.0f);
+    part->gainLeft = part->volume * cosf(angle);
+    part->gainRight = part->volume * sinf(angle);
+}
+
+// Gains ramp across the frames, so volume and pan changes do not zipper
+void synth_partMix(const struct synth_Part *part, float *output, const int frames)
+{
+    const float left = part->fromLeft;
+    const float right = part->fromRight;
+    const float stepLeft = (part->gainLeft - left) / (float) frames;
+    const float stepRight = (part->gainRight - right) / (float) frames;
+    const float *buffer = part->buffer;
+    if (part->stereo) {
+        const float *side = part->side;
+        for (int i = 0; i < frames; i++) {
+            output[2 * i + 0] += (left + stepLeft * (float) (i + 1)) * (buffer[i] + side[i]);
+            output[2 * i + 1] += (right + stepRight * (float) (i + 1)) * (buffer[i] - side[i]);
+        }
+        return;
+    }
+    for (int i = 0; i < frames; i++) {
+        output[2 * i + 0] += (left + stepLeft * (float) (i + 1)) * buffer[i];
+        output[2 * i + 1] += (right + stepRight * (float) (i + 1)) * buffer[i];
+    }
+}
+
+float *synth_partParam(struct synth_Part *part, const enum synth_Param param)
+{
+    switch (param) {
+        case SYNTH_PARAM_VOLUME: return &part->volume;
+        case SYNTH_PARAM_PAN: return &part->pan;
+        case SYNTH_PARAM_ATTACK: return &part->patch.envelope.attackTime;
+        case SYNTH_PARAM_DECAY: return &part->patch.envelope.decayTime;
+        case SYNTH_PARAM_RELEASE: return &part->patch.envelope.releaseTime;
+        case SYNTH_PARAM_START: return &part->patch.envelope.startAmplitude;
+        case SYNTH_PARAM_SUSTAIN: return &part->patch.envelope.sustainAmplitude;
+        case SYNTH_PARAM_GAIN_0:
+        case SYNTH_PARAM_GAIN_1:
+        case SYNTH_PARAM_GAIN_2: return &part->patch.partials[param - SYNTH_PARAM_GAIN_0].gain;
+        case SYNTH_PARAM_LFO_FREQ_0:
+        case SYNTH_PARAM_LFO_FREQ_1:
+        case SYNTH_PARAM_LFO_FREQ_2: return &part->patch.partials[param - SYNTH_PARAM_LFO_FREQ_0].lfoFreq;
+        case SYNTH_PARAM_LFO_DEPTH_0:
+        case SYNTH_PARAM_LFO_DEPTH_1:
+        case SYNTH_PARAM_LFO_DEPTH_2: return &part->patch.partials[param - SYNTH_PARAM_LFO_DEPTH_0].lfoAmplitude;
+        case SYNTH_PARAM_GLIDE: return &part->glide;
+        case SYNTH_PARAM_DETUNE: return &part->detune;
+        case SYNTH_PARAM_SPREAD: return &part->spread;
+        case SYNTH_PARAMS_NUM: break;
+    }
+    assert(false);
+    return NULL;
+}
+
+// Parameters from the first one on jump to the values of the part, ramps stop
+void synth_partSyncParams(struct synth_Part *part, const enum synth_Param first)
+{
+    for (int i = first; i < SYNTH_PARAMS_NUM; i++) {
+        part->params[i].value = *synth_partParam(part, i);
+        synth_paramRampStart(&part->params[i], part->params[i].value, 0);
+    }
+}
+
+// Moves the ramps of the part over the frames, active voices follow the LFOs,
+// the sustain level and the unison settings. Returns true when volume or pan moved
+bool synth_partAdvanceParams(struct synth_Part *part, const int frames)
+{
+    bool gains = false;
+    bool unison = false;
+    bool sustain = false;
+    bool lfos[PARTIALS_NUM] = { false };
+    for (int i = 0; i < SYNTH_PARAMS_NUM; i++) {
+        if (!synth_paramRampAdvance(&part->params[i], frames)) {
+            continue;
+        }
+        *synth_partParam(part, i) = part->params[i].value;
+        if (i == SYNTH_PARAM_VOLUME || i == SYNTH_PARAM_PAN) {
+            gains = true;
+        } else if (i >= SYNTH_PARAM_LFO_FREQ_0 && i <= SYNTH_PARAM_LFO_DEPTH_2) {
+            lfos[(i - SYNTH_PARAM_LFO_FREQ_0) % PARTIALS_NUM] = true;
+        } else if (i == SYNTH_PARAM_DETUNE || i == SYNTH_PARAM_SPREAD) {
+            unison = true;
+        } else if (i == SYNTH_PARAM_SUSTAIN) {
+            sustain = true;
+        }
+    }
+    if (sustain) {
+        synth_voicesSetSustain(&part->voices, part->patch.envelope.sustainAmplitude, frames);
+    }
+    if (unison) {
+        synth_voicesSetUnison(&part->voices, part->voices.unison, part->detune, part->spread);
+    }
+    for (int p = 0; p < PARTIALS_NUM; p++) {
+        if (lfos[p]) {
+            const struct synth_Partial *partial = &part->patch.partials[p];
+            synth_voicesSetLfo(&part->voices, p, partial->lfoFreq, partial->lfoAmplitude, part->sampleRate);
+        }
+    }
+    return gains;
+}
+
+// -------------------------- +Engine --------------------------
+
+struct synth_Engine
+{
+    struct synth_EngineConfig config;
+    float sampleRate;
+    uint32_t noise;
+    uint32_t age;
+    int voicesActive;
+    struct synth_EventQueue events;
+    struct synth_Part parts[SYNTH_PARTS_NUM];
+    float *partBuffers;         // mid and side of every part
+    float *oversampled;
+    float *oversampledSide;
+    bool resampling;
+    struct synth_Resampler resampler;
+    float *internal;
+    struct synth_SampleBank samples;
+    uint64_t frame;
+    int smoothFrames;
+    struct synth_Event pending[SYNTH_EVENTS_NUM];
+    int pendingNum;
+    atomic_int scheduled;       // events stamped for later, queued or pending
+    _Atomic float paramTargets[SYNTH_PARTS_NUM][SYNTH_PARAMS_NUM];
+    float paramsSeen[SYNTH_PARTS_NUM][SYNTH_PARAMS_NUM];
+    atomic_uint paramWrites;
+    unsigned paramWritesSeen;
+    float load;
+    enum synth_Quality quality;
+    _Atomic float statsLoad;
+    atomic_int statsQuality;
+    atomic_int statsVoices;
+    atomic_ulong statsStolen;
+    atomic_ulong statsDropped;
+    _Atomic uint64_t statsFrame;
+#if SYNTH_PROFILE
+    struct synth_Profile profile;
+#endif
+};
+
+void synth_engineConfigDefault(struct synth_EngineConfig *config)
+{
+    assert(config != NULL);
+    config->sampleRate = DEFAULT_SAMPLE_RATE;
+    config->outputRate = 0;
+    config->resamplerQuality = SYNTH_RESAMPLER_MEDIUM;
+    config->voicesNum = DEFAULT_VOICES_NUM;
+    config->maxFrames = DEFAULT_MAX_FRAMES;
+    config->oversampling = DEFAULT_OVERSAMPLING;
+    config->stealPolicy = SYNTH_STEAL_QUIETEST;
+    config->loadReduce = 0.6f;
+    config->loadCheap = 0.75f;
+    config->loadSteal = 0.9f;
+}
+
+void synth_engineResetParts(struct synth_Engine *engine)
+{
+    for (int i = 0; i < SYNTH_PARTS_NUM; i++) {
+        struct synth_Part *part = &engine->parts[i];
+        part->patch = g_patches[i == 0 ? SYNTH_PATCH_HARMONICA : SYNTH_PATCH_BELL];
+        part->volume = 1.0f;
+        part->pan = 0.0f;
+        part->voicesBudget = engine->config.voicesNum;
+        part->sample = -1;
+        part->sampleRate = engine->sampleRate * engine->config.oversampling;
+        part->mode = SYNTH_VOICE_MODE_POLY;
+        part->glide = 0.0f;
+        part->detune = 20.0f;
+        part->spread = 0.5f;
+        part->heldNum = 0;
+        part->monoNote = -1;
+        part->lastNote = -1;
+        synth_voicesSetUnison(&part->voices, 1, part->detune, part->spread);
+        part->buffer = engine->partBuffers + (size_t) (2 * i) * engine->config.maxFrames;
+        part->side = engine->partBuffers + (size_t) (2 * i + 1) * engine->config.maxFrames;
+        synth_partUpdateGains(part);
+        part->fromLeft = part->gainLeft;
+        part->fromRight = part->gainRight;
+        synth_partSyncParams(part, 0);
+        for (int j = 0; j < SYNTH_PARAMS_NUM; j++) {
+            engine->paramsSeen[i][j] = part->params[j].value;
+            atomic_store_explicit(&engine->paramTargets[i][j], part->params[j].value, memory_order_relaxed);
+        }
+    }
+}
+
+struct synth_Engine *synth_engineCreate(const struct synth_EngineConfig *config)
+{
+    assert(config != NULL);
+    if (config->sampleRate <= 0 || config->outputRate < 0 || config->voicesNum <= 0 || config->maxFrames <= 0
+            || !synth_oversamplerIsFactorValid(config->oversampling)
+            || config->resamplerQuality < SYNTH_RESAMPLER_FAST || config->resamplerQuality > SYNTH_RESAMPLER_BEST) {
+        return NULL;
+    }
+    struct synth_Engine *engine = aligned_alloc(_Alignof(struct synth_Engine), sizeof(struct synth_Engine));
+    if (engine == NULL) {
+        return NULL;
+    }
+    memset(engine, 0, sizeof(struct synth_Engine));
+    if (!synth_sampleBankInit(&engine->samples)) {
+        free(engine);
+        return NULL;
+    }
+    engine->config = *config;
+    engine->config.maxFrames = (config->maxFrames + BUFFER_ALIGN_FLOATS - 1) & ~(BUFFER_ALIGN_FLOATS - 1);
+    engine->sampleRate = (float) config->sampleRate;
+    engine->resampling = config->outputRate != 0 && config->outputRate != config->sampleRate;
+    engine->noise = 0x9E3779B9u;
+    engine->smoothFrames = (int) (engine->sampleRate * SMOOTH_TIME);
+    synth_eventQueueInit(&engine->events);
+    const size_t buffersSize = (size_t) 2 * SYNTH_PARTS_NUM * engine->config.maxFrames * sizeof(float);
+    const size_t oversampledSize = (size_t) SYNTH_OVERSAMPLING_MAX * engine->config.maxFrames * sizeof(float);
+    engine->partBuffers = aligned_alloc(BUFFER_ALIGN, buffersSize);
+    engine->oversampled = aligned_alloc(BUFFER_ALIGN, oversampledSize);
+    engine->oversampledSide = aligned_alloc(BUFFER_ALIGN, oversampledSize);
+    if (engine->partBuffers == NULL || engine->oversampled == NULL || engine->oversampledSide == NULL) {
+        synth_engineDestroy(engine);
+        return NULL;
+    }
+    memset(engine->partBuffers, 0, buffersSize);
+    memset(engine->oversampled, 0, oversampledSize);
+    memset(engine->oversampledSide, 0, oversampledSize);
+    if (engine->resampling) {
+        const size_t internalSize = (size_t) engine->config.maxFrames * SYNTH_OUTPUT_CHANNELS * sizeof(float);
+        engine->internal = aligned_alloc(BUFFER_ALIGN, internalSize);
+        if (engine->internal == NULL
+                || !synth_resamplerCreate(&engine->resampler, config->sampleRate, config->outputRate, config->resamplerQuality, engine->config.maxFrames)) {
+            synth_engineDestroy(engine);
+            return NULL;
+        }
+        memset(engine->internal, 0, internalSize);
+    }
+    for (int i = 0; i < SYNTH_PARTS_NUM; i++) {
+        if (!synth_voicesCreate(&engine->parts[i].voices, config->voicesNum)
+                || !synth_oversamplerCreate(&engine->parts[i].oversampler, config->oversampling, engine->config.maxFrames)
+                || !synth_oversamplerCreate(&engine->parts[i].sideOversampler, config->oversampling, engine->config.maxFrames)) {
+            synth_engineDestroy(engine);
+            return NULL;
+        }
+    }
+#if SYNTH_PROFILE
+    synth_profileInit(&engine->profile);
+    for (int i = 0; i < SYNTH_PARTS_NUM; i++) {
+        engine->parts[i].voices.profile = ENGINE_PROFILE(engine);
+    }
+#endif
+    synth_engineResetParts(engine);
+    return engine;
+}
+
+void synth_engineDestroy(struct synth_Engine *engine)
+{
+    if (engine == NULL) {
+        return;
+    }
+    for (int i = 0; i < SYNTH_PARTS_NUM; i++) {
+        synth_voicesDestroy(&engine->parts[i].voices);
+        synth_oversamplerDestroy(&engine->parts[i].oversampler);
+        synth_oversamplerDestroy(&engine->parts[i].sideOversampler);
+    }
+    free(engine->partBuffers);
+    free(engine->oversampled);
+    free(engine->oversampledSide);
+    free(engine->internal);
+    synth_resamplerDestroy(&engine->resampler);
+    synth_sampleBankDestroy(&engine->samples);
+    free(engine);
+}
+
+/*
+ * Events stamped later than the rendered frames take a slot of the pending
+ * list before they are queued, so the render thread always has room for
+ * them and keeps draining the queue. Live input never waits behind a long
+ * automation curve, the curve waits for its own earlier points instead.
+ */
+bool synth_enginePushScheduled(struct synth_Engine *engine, struct synth_Event *event)
+{
+    event->scheduled = event->frame > synth_engineGetFrame(engine);
+    if (event->scheduled && atomic_fetch_add_explicit(&engine->scheduled, 1, memory_order_relaxed) >= SYNTH_EVENTS_NUM) {
+        atomic_fetch_sub_explicit(&engine->scheduled, 1, memory_order_relaxed);
+        return false;
+    }
+    if (!synth_eventQueuePush(&engine->events, event)) {
+        if (event->scheduled) {
+            atomic_fetch_sub_explicit(&engine->scheduled, 1, memory_order_relaxed);
+        }
+        return false;
+    }
+    return true;
+}
+
+bool synth_enginePushEventAt(struct synth_Engine *engine, const enum synth_EventType type, const int part, const int note, const float value, const uint64_t frame)
+{
+    assert(engine != NULL);
+    if (part < 0 || part >= SYNTH_PARTS_NUM) {
+        return false;
+    }
+    struct synth_Event event = { type, part, note, value, frame, 0, false };
+    return synth_enginePushScheduled(engine, &event);
+}
+
+bool synth_enginePushEvent(struct synth_Engine *engine, const enum synth_EventType type, const int part, const int note, const float value)
+{
+    return synth_enginePushEventAt(engine, type, part, note, value, 0);
+}
+
+// Higher notes would overflow the phase increments of the oscillators
+bool synth_enginePushNote(struct synth_Engine *engine, const enum synth_EventType type, const int part, const int note, const uint64_t frame)
+{
+    if (note < 0 || note > SYNTH_NOTE_MAX) {
+        return false;
+    }
+    return synth_enginePushEventAt(engine, type, part, note, 0.0f, frame);
+}
+
+bool synth_engineNoteOn(struct synth_Engine *engine, const int part, const int note)
+{
+    return synth_enginePushNote(engine, EVENT_TYPE_NOTE_ON, part, note, 0);
+}
+
+bool synth_engineNoteOff(struct synth_Engine *engine, const int part, const int note)
+{
+    return synth_enginePushNote(engine, EVENT_TYPE_NOTE_OFF, part, note, 0);
+}
+
+bool synth_engineNoteOnAt(struct synth_Engine *engine, const int part, const int note, const uint64_t frame)
+{
+    return synth_enginePushNote(engine, EVENT_TYPE_NOTE_ON, part, note, frame);
+}
+
+bool synth_engineNoteOffAt(struct synth_Engine *engine, const int part, const int note, const uint64_t frame)
+{
+    return synth_enginePushNote(engine, EVENT_TYPE_NOTE_OFF, part, note, frame);
+}
+
+bool synth_engineSetPartPatch(struct synth_Engine *engine, const int part, const enum synth_PatchId patch)
+{
+    if (patch < 0 || patch >= SYNTH_PATCHES_NUM) {
+        return false;
+    }
+    return synth_enginePushEvent(engine, EVENT_TYPE_PART_PATCH, part, 0, (float) patch);
+}
+
+bool synth_engineSetPartVolume(struct synth_Engine *engine, const int part, const float volume)
+{
+    return synth_enginePushEvent(engine, EVENT_TYPE_PART_VOLUME, part, 0, volume);
+}
+
+bool synth_engineSetPartPan(struct synth_Engine *engine, const int part, const float pan)
+{
+    if (pan < -1.0f || pan > 1.0f) {
+        return false;
+    }
+    return synth_enginePushEvent(engine, EVENT_TYPE_PART_PAN, part, 0, pan);
+}
+
+bool synth_engineSetPartVoices(struct synth_Engine *engine, const int part, const int voices)
+{
+    if (voices < 0) {
+        return false;
+    }
+    return synth_enginePushEvent(engine, EVENT_TYPE_PART_VOICES, part, 0, (float) voices);
+}
+
+bool synth_engineSetPartMode(struct synth_Engine *engine, const int part, const enum synth_VoiceMode mode)
+{
+    if (mode < SYNTH_VOICE_MODE_POLY || mode > SYNTH_VOICE_MODE_LEGATO) {
+        return false;
+    }
+    return synth_enginePushEvent(engine, EVENT_TYPE_PART_MODE, part, 0, (float) mode);
+}
+
+bool synth_engineSetPartUnison(struct synth_Engine *engine, const int part, const int unison)
+{
+    if (unison < 1 || unison > SYNTH_UNISON_MAX) {
+        return false;
+    }
+    return synth_enginePushEvent(engine, EVENT_TYPE_PART_UNISON, part, 0, (float) unison);
+}
+
+bool synth_engineSetPartOversampling(struct synth_Engine *engine, const int part, const int factor)
+{
+    if (!synth_oversamplerIsFactorValid(factor)) {
+        return false;
+    }
+    return synth_enginePushEvent(engine, EVENT_TYPE_PART_OVERSAMPLING, part, 0, (float) factor);
+}
+
+bool synth_engineSetParam(struct synth_Engine *engine, const int part, const enum synth_Param param, const float value)
+{
+    assert(engine != NULL);
+    if (part < 0 || part >= SYNTH_PARTS_NUM || param < 0 || param >= SYNTH_PARAMS_NUM || isnan(value)) {
+        return false;
+    }
+    atomic_store_explicit(&engine->paramTargets[part][param], value, memory_order_relaxed);
+    atomic_fetch_add_explicit(&engine->paramWrites, 1, memory_order_release);
+    return true;
+}
+
+bool synth_engineAutomateParam(struct synth_Engine *engine, const int part, const enum synth_Param param, const float value, const uint64_t frame, const int length)
+{
+    assert(engine != NULL);
+    if (part < 0 || part >= SYNTH_PARTS_NUM || param < 0 || param >= SYNTH_PARAMS_NUM || isnan(value) || length < 0) {
+        return false;
+    }
+    const uint64_t start = frame > (uint64_t) length ? frame - length : 0;
+    struct synth_Event event = { EVENT_TYPE_PARAM, part, param, value, start, (int) (frame - start), false };
+    return synth_enginePushScheduled(engine, &event);
+}
+
+uint64_t synth_engineGetFrame(struct synth_Engine *engine)
+{
+    assert(engine != NULL);
+    return atomic_load_explicit(&engine->statsFrame, memory_order_relaxed);
+}
+
+int synth_engineLoadSample(struct synth_Engine *engine, const char *path)
+{
+    assert(engine != NULL);
+    assert(path != NULL);
+    return synth_sampleBankLoad(&engine->samples, path);
+}
+
+bool synth_engineSetPartSample(struct synth_Engine *engine, const int part, const int sample)
+{
+    if (sample < -1 || sample >= SYNTH_SAMPLES_NUM) {
+        return false;
+    }
+    return synth_enginePushEvent(engine, EVENT_TYPE_PART_SAMPLE, part, 0, (float) sample);
+}
+
+// Released voices go first, then the policy decides between the rest
+bool synth_engineIsStealBetter(const struct synth_Engine *engine, const struct synth_Voices *candidates, const int candidate, const struct synth_Voices *victims, const int victim)
+{
+    const bool candidateReleased = candidates->stage[candidate] == ENVELOPE_STAGE_RELEASE;
+    const bool victimReleased = victims->stage[victim] == ENVELOPE_STAGE_RELEASE;
+    if (candidateReleased != victimReleased) {
+        return candidateReleased;
+    }
+    if (engine->config.stealPolicy == SYNTH_STEAL_OLDEST) {
+        return candidates->age[candidate] < victims->age[victim];
+    }
+    return candidates->level[candidate] < victims->level[victim];
+}
+
+// With part equal to -1 any part may lose a voice
+bool synth_engineStealVoice(struct synth_Engine *engine, const int part)
+{
+    if (engine->config.stealPolicy == SYNTH_STEAL_NONE) {
+        return false;
+    }
+    struct synth_Voices *victims = NULL;
+    int victim = -1;
+    for (int i = 0; i < SYNTH_PARTS_NUM; i++) {
+        if (part >= 0 && i != part) {
+            continue;
+        }
+        struct synth_Voices *voices = &engine->parts[i].voices;
+        for (int k = 0; k < voices->num; k++) {
+            if (victims == NULL || synth_engineIsStealBetter(engine, voices, k, victims, victim)) {
+                victims = voices;
+                victim = k;
+            }
+        }
+    }
+    if (victims == NULL) {
+        return false;
+    }
+    synth_voicesRemove(victims, victim);
+    engine->voicesActive--;
+    atomic_fetch_add_explicit(&engine->statsStolen, 1, memory_order_relaxed);
+    return true;
+}
+
+bool synth_engineReserveVoice(struct synth_Engine *engine, const int part)
+{
+    bool reserved;
+    if (engine->parts[part].voices.num >= engine->parts[part].voicesBudget) {
+        reserved = synth_engineStealVoice(engine, part);
+    } else if (engine->voicesActive >= engine->config.voicesNum) {
+        reserved = synth_engineStealVoice(engine, -1);
+    } else {
+        reserved = true;
+    }
+    if (!reserved) {
+        atomic_fetch_add_explicit(&engine->statsDropped, 1, memory_order_relaxed);
+    }
+    return reserved;
+}
+
+// Glides last the glide time of the part, from its previous note
+int synth_engineGlideSamples(const struct synth_Part *part)
+{
+    return part->lastNote < 0 ? 0 : (int) (part->glide * part->sampleRate);
+}
+
+// Index of the new voice or -1, it slides in from the previous note of the part
+int synth_engineStartVoice(struct synth_Engine *engine, const int partIndex, const int note)
+{
+    struct synth_Part *part = &engine->parts[partIndex];
+    struct synth_Voices *voices = &part->voices;
+    if (!synth_engineReserveVoice(engine, partIndex)) {
+        return -1;
+    }
+    const int from = part->lastNote >= 0 ? part->lastNote : note;
+    const int started = synth_voicesStart(voices, &part->patch, from, engine->age++, part->sampleRate);
+    if (started < 0) {
+        return -1;
+    }
+    engine->voicesActive++;
+    const struct synth_Sample *sample = synth_sampleBankGet(&engine->samples, part->sample);
+    if (sample != NULL) {
+        synth_voicesAttachSample(voices, sample, started, part->sampleRate);
+        synth_sampleBankRequest(&engine->samples, part->sample, sample->attackFrames);
+    }
+    synth_voicesGlide(voices, &part->patch, sample, started, note, synth_engineGlideSamples(part), part->sampleRate);
+    part->lastNote = note;
+    return started;
+}
+
+void synth_partForgetNote(struct synth_Part *part, const int note)
+{
+    int kept = 0;
+    for (int i = 0; i < part->heldNum; i++) {
+        if (part->held[i] != note) {
+            part->held[kept++] = part->held[i];
+        }
+    }
+    part->heldNum = kept;
+}
+
+/*
+ * One voice follows the last held note. A new note, or a release that
+ * uncovers a note still held, moves the voice to it. Mono attacks again
+ * from the current level every time, legato only when the voice was
+ * already releasing.
+ */
+void synth_engineHandleMonoNote(struct synth_Engine *engine, const struct synth_Event *event)
+{
+    struct synth_Part *part = &engine->parts[event->part];
+    struct synth_Voices *voices = &part->voices;
+    synth_partForgetNote(part, event->note);
+    if (event->type == EVENT_TYPE_NOTE_ON) {
+        if (part->heldNum == HELD_NOTES_NUM) {
+            synth_partForgetNote(part, part->held[0]);
+        }
+        part->held[part->heldNum++] = event->note;
+    } else if (event->note != part->monoNote) {
+        return;
+    }
+    const int index = part->monoNote >= 0 ? synth_voicesFindAge(voices, part->monoAge) : -1;
+    if (index < 0) {
+        part->monoNote = -1;
+        if (event->type == EVENT_TYPE_NOTE_ON) {
+            const int started = synth_engineStartVoice(engine, event->part, event->note);
+            if (started >= 0) {
+                part->monoNote = event->note;
+                part->monoAge = voices->age[started];
+            }
+        }
+        return;
+    }
+    if (part->heldNum == 0) {
+        synth_voicesRelease(voices, &part->patch, index, part->sampleRate);
+        return;
+    }
+    const int note = part->held[part->heldNum - 1];
+    const bool released = voices->stage[index] == ENVELOPE_STAGE_RELEASE;
+    const struct synth_Sample *sample = synth_sampleBankGet(&engine->samples, part->sample);
+    synth_voicesGlide(voices, &part->patch, sample, index, note, synth_engineGlideSamples(part), part->sampleRate);
+    if (part->mode == SYNTH_VOICE_MODE_MONO || released) {
+        synth_voicesRetrigger(voices, &part->patch, index, part->sampleRate);
+    }
+    part->monoNote = note;
+    part->lastNote = note;
+}
+
+void synth_engineHandleNote(struct synth_Engine *engine, const struct synth_Event *event)
+{
+    struct synth_Part *part = &engine->parts[event->part];
+    struct synth_Voices *voices = &part->voices;
+    if (part->mode != SYNTH_VOICE_MODE_POLY) {
+        synth_engineHandleMonoNote(engine, event);
+        return;
+    }
+    const int index = synth_voicesFind(voices, event->note);
+    if (index < 0) {
+        if (event->type == EVENT_TYPE_NOTE_ON) {
+            synth_engineStartVoice(engine, event->part, event->note);
+        }
+    } else if (event->type == EVENT_TYPE_NOTE_ON) {
+        if (voices->stage[index] == ENVELOPE_STAGE_RELEASE) {
+            synth_voicesRetrigger(voices, &part->patch, index, part->sampleRate);
+        }
+    } else {
+        if (voices->stage[index] != ENVELOPE_STAGE_RELEASE) {
+            synth_voicesRelease(voices, &part->patch, index, part->sampleRate);
+        }
+    }
+}
+
+void synth_engineHandleEvent(struct synth_Engine *engine, const struct synth_Event *event)
+{
+    struct synth_Part *part = &engine->parts[event->part];
+    switch (event->type) {
+        case EVENT_TYPE_NOTE_ON:
+        case EVENT_TYPE_NOTE_OFF:
+        {
+            synth_engineHandleNote(engine, event);
+            break;
+        }
+        case EVENT_TYPE_PART_PATCH:
+        {
+            part->patch = g_patches[(int) event->value];
+            synth_partSyncParams(part, SYNTH_PARAM_ATTACK);
+            break;
+        }
+        case EVENT_TYPE_PART_VOLUME:
+        {
+            synth_paramRampStart(&part->params[SYNTH_PARAM_VOLUME], synth_paramClamp(SYNTH_PARAM_VOLUME, event->value), engine->smoothFrames);
+            break;
+        }
+        case EVENT_TYPE_PART_PAN:
+        {
+            synth_paramRampStart(&part->params[SYNTH_PARAM_PAN], event->value, engine->smoothFrames);
+            break;
+        }
+        case EVENT_TYPE_PART_VOICES:
+        {
+            part->voicesBudget = (int) event->value;
+            break;
+        }
+        case EVENT_TYPE_PART_OVERSAMPLING:
+        {
+            const int factor = (int) event->value;
+            synth_voicesRescale(&part->voices, (float) factor / (float) part->oversampler.factor);
+            synth_oversamplerSetFactor(&part->oversampler, factor);
+            synth_oversamplerSetFactor(&part->sideOversampler, factor);
+            part->sampleRate = engine->sampleRate * factor;
+            break;
+        }
+        case EVENT_TYPE_PART_SAMPLE:
+        {
+            engine->voicesActive -= part->voices.num;
+            while (part->voices.num > 0) {
+                synth_voicesRemove(&part->voices, part->voices.num - 1);
+            }
+            synth_oversamplerReset(&part->oversampler);
+            synth_oversamplerReset(&part->sideOversampler);
+            part->sample = (int) event->value;
+            part->heldNum = 0;
+            part->monoNote = -1;
+            break;
+        }
+        case EVENT_TYPE_PART_MODE:
+        {
+            for (int k = 0; k < part->voices.num; k++) {
+                if (part->voices.stage[k] != ENVELOPE_STAGE_RELEASE) {
+                    synth_voicesRelease(&part->voices, &part->patch, k, part->sampleRate);
+                }
+            }
+            part->mode = (enum synth_VoiceMode) event->value;
+            part->heldNum = 0;
+            part->monoNote = -1;
+            break;
+        }
+        case EVENT_TYPE_PART_UNISON:
+        {
+            synth_voicesSetUnison(&part->voices, (int) event->value, part->detune, part->spread);
+            break;
+        }
+        case EVENT_TYPE_PARAM:
+        {
+            const int64_t length = (int64_t) (event->frame + event->length) - (int64_t) engine->frame;
+            synth_paramRampStart(&part->params[event->note], synth_paramClamp(event->note, event->value), length > 0 ? (int) length : 0);
+            break;
+        }
+    }
+}
+
+// A scheduled event gives its slot back once handled
+void synth_engineHandleDueEvent(struct synth_Engine *engine, const struct synth_Event *event)
+{
+    synth_engineHandleEvent(engine, event);
+    if (event->scheduled) {
+        atomic_fetch_sub_explicit(&engine->scheduled, 1, memory_order_relaxed);
+    }
+}
+
+/*
+ * Handles the events due now, later ones wait in the pending list in the
+ * order they came. Only scheduled events can be later, the list has a slot
+ * for each, so the queue is always drained. Returns the frames until the
+ * next pending event, at most frames.
+ */
+int synth_engineProcessEvents(struct synth_Engine *engine, const int frames)
+{
+    const uint64_t now = engine->frame;
+    uint64_t next = now + frames;
+    int kept = 0;
+    for (int i = 0; i < engine->pendingNum; i++) {
+        const struct synth_Event *event = &engine->pending[i];
+        if (event->frame <= now) {
+            synth_engineHandleDueEvent(engine, event);
+            continue;
+        }
+        next = event->frame < next ? event->frame : next;
+        engine->pending[kept++] = *event;
+    }
+    engine->pendingNum = kept;
+    struct synth_Event event;
+    while (synth_eventQueuePop(&engine->events, &event)) {
+        if (event.frame <= now) {
+            synth_engineHandleDueEvent(engine, &event);
+            continue;
+        }
+        assert(event.scheduled && engine->pendingNum < SYNTH_EVENTS_NUM);
+        next = event.frame < next ? event.frame : next;
+        engine->pending[engine->pendingNum++] = event;
+    }
+    return (int) (next - now);
+}
+
+/*
+ * Live writes start a glide on every parameter whose target moved since the
+ * last look. Jumps land before the sub-block and ramps move across it. The
+ * sub-block ends where a volume or pan ramp does, so the gains the mix
+ * interpolates stay on the ramp. Returns the frames of the sub-block.
+ */
+int synth_engineUpdateParams(struct synth_Engine *engine, int frames)
+{
+    const unsigned writes = atomic_load_explicit(&engine->paramWrites, memory_order_acquire);
+    const bool written = writes != engine->paramWritesSeen;
+    engine->paramWritesSeen = writes;
+    for (int i = 0; i < SYNTH_PARTS_NUM; i++) {
+        struct synth_Part *part = &engine->parts[i];
+        for (int j = 0; written && j < SYNTH_PARAMS_NUM; j++) {
+            const float target = atomic_load_explicit(&engine->paramTargets[i][j], memory_order_relaxed);
+            if (target != engine->paramsSeen[i][j]) {
+                engine->paramsSeen[i][j] = target;
+                synth_paramRampStart(&part->params[j], synth_paramClamp(j, target), engine->smoothFrames);
+            }
+        }
+        if (synth_partAdvanceParams(part, 0)) {
+            synth_partUpdateGains(part);
+        }
+        for (int j = SYNTH_PARAM_VOLUME; j <= SYNTH_PARAM_PAN; j++) {
+            const int remaining = part->params[j].remaining;
+            frames = remaining > 0 && remaining < frames ? remaining : frames;
+        }
+    }
+    for (int i = 0; i < SYNTH_PARTS_NUM; i++) {
+        struct synth_Part *part = &engine->parts[i];
+        part->fromLeft = part->gainLeft;
+        part->fromRight = part->gainRight;
+        if (synth_partAdvanceParams(part, frames)) {
+            synth_partUpdateGains(part);
+        }
+    }
+    return frames;
+}
+
+// -------------------------- +Governor --------------------------
+
+double synth_engineGetClock()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e+9;
+}
+
+/*
+ * Load is the render time of a block over its duration. It rises at once
+ * and falls slowly, the quality follows it through the configured
+ * thresholds with some hysteresis to avoid flapping.
+ */
+void synth_engineGovern(struct synth_Engine *engine, const double elapsed, const int frames)
+{
+    const float load = (float) (elapsed * engine->config.sampleRate / frames);
+    if (load > engine->load) {
+        engine->load = load;
+    } else {
+        engine->load += (load - engine->load) * LOAD_RELEASE;
+    }
+    const float thresholds[] = { 0.0f, engine->config.loadReduce, engine->config.loadCheap, engine->config.loadSteal };
+    enum synth_Quality quality = engine->quality;
+    while (quality < SYNTH_QUALITY_STEAL && engine->load > thresholds[quality + 1]) {
+        quality++;
+    }
+    while (quality > SYNTH_QUALITY_FULL && engine->load < thresholds[quality] * LOAD_HYSTERESIS) {
+        quality--;
+    }
+    if (quality != engine->quality) {
+        logw("Load %.2f, quality changes from %d to %d", engine->load, engine->quality, quality);
+        engine->quality = quality;
+    }
+    if (engine->quality == SYNTH_QUALITY_STEAL) {
+        synth_engineStealVoice(engine, -1);
+    }
+    atomic_store_explicit(&engine->statsLoad, engine->load, memory_order_relaxed);
+    atomic_store_explicit(&engine->statsQuality, engine->quality, memory_order_relaxed);
+    atomic_store_explicit(&engine->statsVoices, engine->voicesActive, memory_order_relaxed);
+}
+
+void synth_engineGetStats(struct synth_Engine *engine, struct synth_EngineStats *stats)
+{
+    assert(engine != NULL);
+    assert(stats != NULL);
+    stats->load = atomic_load_explicit(&engine->statsLoad, memory_order_relaxed);
+    stats->quality = atomic_load_explicit(&engine->statsQuality, memory_order_relaxed);
+    stats->voices = atomic_load_explicit(&engine->statsVoices, memory_order_relaxed);
+    stats->stolen = atomic_load_explicit(&engine->statsStolen, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&engine->statsDropped, memory_order_relaxed);
+    stats->scheduled = atomic_load_explicit(&engine->scheduled, memory_order_relaxed);
+}
+
+bool synth_engineGetProfile(struct synth_Engine *engine, struct synth_ProfileStats *stats)
+{
+    assert(engine != NULL);
+    assert(stats != NULL);
+#if SYNTH_PROFILE
+    synth_profileGet(&engine->profile, stats);
+    return true;
+#else
+    memset(stats, 0, sizeof(struct synth_ProfileStats));
+    return false;
+#endif
+}
+
+int synth_engineDrainProfile(struct synth_Engine *engine, struct synth_ProfileBlock *blocks, const int max)
+{
+    assert(engine != NULL);
+#if SYNTH_PROFILE
+    return synth_profileDrain(&engine->profile, blocks, max);
+#else
+    (void) blocks;
+    (void) max;
+    return 0;
+#endif
+}
+
+// -------------------------- +Render --------------------------
+
+// Every voice asks for the frames ahead once it crosses a stride, loop wraps ask again
+void synth_engineRequestSamples(struct synth_Engine *engine, const struct synth_Part *part, const int frames)
+{
+    const struct synth_Voices *voices = &part->voices;
+    for (int k = 0; k < voices->num; k++) {
+        const int advance = (int) (frames * voices->increment[0][k]) + 1;
+        if (voices->position[k] % SAMPLE_REQUEST_STRIDE < advance) {
+            synth_sampleBankRequest(&engine->samples, part->sample, voices->position[k]);
+        }
+    }
+}
+
+/*
+ * Every part renders its voices into its own buffer, then every sounding part
+ * is panned into the interleaved output. Part buffers are contiguous and
+ * block sized, so a block of all 16 parts stays in cache.
+ *
+ * Oversampled parts render into the shared scratch buffer at their own rate
+ * and are decimated into the part buffer. Their filter history is cleared
+ * once a part falls silent, so the next note does not start with a stale
+ * tail.
+ */
+void synth_engineRenderParts(struct synth_Engine *engine, float *output, const int frames)
+{
+    for (int i = 0; i < SYNTH_PARTS_NUM; i++) {
+        struct synth_Part *part = &engine->parts[i];
+        const int voices = part->voices.num;
+        if (voices == 0) {
+            continue;
+        }
+        PROFILE_MARK(mark);
+        const int factor = part->oversampler.factor;
+        const struct synth_Sample *sample = synth_sampleBankGet(&engine->samples, part->sample);
+        const bool stereo = sample == NULL && part->voices.unison > 1 && part->spread > 0.0f;
+        if (stereo && !part->stereo) {
+            synth_oversamplerReset(&part->sideOversampler);
+        }
+        part->stereo = stereo;
+        if (factor == 1) {
+            synth_voicesRender(&part->voices, &part->patch, sample, engine->quality, part->sampleRate, &engine->noise, part->buffer, stereo ? part->side : NULL, frames);
+        } else {
+            synth_voicesRender(&part->voices, &part->patch, sample, engine->quality, part->sampleRate, &engine->noise, engine->oversampled, stereo ? engine->oversampledSide : NULL, frames * factor);
+            synth_oversamplerProcess(&part->oversampler, engine->oversampled, part->buffer, frames);
+            if (stereo) {
+                synth_oversamplerProcess(&part->sideOversampler, engine->oversampledSide, part->side, frames);
+            }
+            if (part->voices.num == 0) {
+                synth_oversamplerReset(&part->oversampler);
+                synth_oversamplerReset(&part->sideOversampler);
+            }
+        }
+        engine->voicesActive -= voices - part->voices.num;
+        if (sample != NULL) {
+            synth_engineRequestSamples(engine, part, frames * factor);
+        }
+        PROFILE_LAP(ENGINE_PROFILE(engine), SYNTH_STAGE_VOICES, mark);
+        synth_partMix(part, output, frames);
+        PROFILE_LAP(ENGINE_PROFILE(engine), SYNTH_STAGE_MIX, mark);
+    }
+}
+
+// The block is split at every pending event, so they land on their exact frame
+void synth_engineRenderBlock(struct synth_Engine *engine, float *output, const int frames)
+{
+    PROFILE_MARK(clear);
+    memset(output, 0, frames * SYNTH_OUTPUT_CHANNELS * sizeof(float));
+    PROFILE_LAP(ENGINE_PROFILE(engine), SYNTH_STAGE_MIX, clear);
+    int done = 0;
+    while (done < frames) {
+        PROFILE_MARK(mark);
+        const int chunk = synth_engineUpdateParams(engine, synth_engineProcessEvents(engine, frames - done));
+        PROFILE_LAP(ENGINE_PROFILE(engine), SYNTH_STAGE_EVENTS, mark);
+        synth_engineRenderParts(engine, output + done * SYNTH_OUTPUT_CHANNELS, chunk);
+        engine->frame += chunk;
+        done += chunk;
+    }
+    atomic_store_explicit(&engine->statsFrame, engine->frame, memory_order_relaxed);
+}
+
+void synth_engineRenderTimed(struct synth_Engine *engine, float *output, const int frames)
+{
+#if SYNTH_PROFILE
+    synth_profileBeginBlock(&engine->profile);
+#endif
+    const double start = synth_engineGetClock();
+    synth_engineRenderBlock(engine, output, frames);
+    synth_engineGovern(engine, synth_engineGetClock() - start, frames);
+#if SYNTH_PROFILE
+    synth_profileEndBlock(&engine->profile, frames);
+#endif
+}
+
+// Whole internal blocks feed the resampler whenever it runs dry
+void synth_engineRenderResampled(struct synth_Engine *engine, float *output, const int frames)
+{
+    int done = 0;
+    for (;;) {
+        PROFILE_MARK(pull);
+        done += synth_resamplerPull(&engine->resampler, output + done * SYNTH_OUTPUT_CHANNELS, frames - done);
+        PROFILE_LAP(ENGINE_PROFILE(engine), SYNTH_STAGE_OUTPUT, pull);
+        if (done >= frames) {
+            break;
+        }
+        synth_engineRenderTimed(engine, engine->internal, engine->config.maxFrames);
+        PROFILE_MARK(push);
+        synth_resamplerPush(&engine->resampler, engine->internal, engine->config.maxFrames);
+        PROFILE_LAP(ENGINE_PROFILE(engine), SYNTH_STAGE_OUTPUT, push);
+    }
+}
+
+void synth_engineRender(struct synth_Engine *engine, float *output, const int frames)
+{
+    assert(engine != NULL);
+    assert(output != NULL);
+    if (engine->resampling) {
+        synth_engineRenderResampled(engine, output, frames);
+        return;
+    }
+    int done = 0;
+    while (done < frames) {
+        int block = frames - done;
+        if (block > engine->config.maxFrames) {
+            block = engine->config.maxFrames;
+        }
+        synth_engineRenderTimed(engine, output + done * SYNTH_OUTPUT_CHANNELS, block);
+        done += block;
+    }
+}
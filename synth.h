@@ -0,0 +1,267 @@
+#ifndef SYNTH_H_
+#define SYNTH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// -------------------------- +Const --------------------------
+
+#define       SYNTH_PARTS_NUM       16
+#define       SYNTH_OUTPUT_CHANNELS 2
+
+#define       SYNTH_EVENTS_NUM      1024
+
+// Oversampling factors are 1, 2, 4 or 8
+#define       SYNTH_OVERSAMPLING_MAX 8
+
+#define       SYNTH_SAMPLES_NUM     64
+
+// Notes are semitones from 0, the lowest key, to SYNTH_NOTE_MAX
+#define       SYNTH_NOTE_MAX        127
+
+// Oscillators of one unison stack
+#define       SYNTH_UNISON_MAX      8
+
+// -------------------------- +Patches --------------------------
+
+enum synth_PatchId
+{
+    SYNTH_PATCH_HARMONICA,
+    SYNTH_PATCH_BELL,
+    SYNTH_PATCHES_NUM
+};
+
+// -------------------------- +Params --------------------------
+
+/*
+ * Numbered parameters of a part: its mix settings, its own copy of the
+ * patch and how its voices play. Partials count from the fundamental.
+ * Switching the patch resets the patch parameters to the new patch.
+ * Attack, decay, release and start apply to voices from their next
+ * envelope stage, held voices follow the sustain level as it moves.
+ */
+enum synth_Param
+{
+    SYNTH_PARAM_VOLUME,
+    SYNTH_PARAM_PAN,        // from -1 (left) to +1 (right)
+    SYNTH_PARAM_ATTACK,     // seconds
+    SYNTH_PARAM_DECAY,      // seconds
+    SYNTH_PARAM_RELEASE,    // seconds
+    SYNTH_PARAM_START,      // amplitude at the end of the attack
+    SYNTH_PARAM_SUSTAIN,    // amplitude
+    SYNTH_PARAM_GAIN_0,
+    SYNTH_PARAM_GAIN_1,
+    SYNTH_PARAM_GAIN_2,
+    SYNTH_PARAM_LFO_FREQ_0, // Hz
+    SYNTH_PARAM_LFO_FREQ_1,
+    SYNTH_PARAM_LFO_FREQ_2,
+    SYNTH_PARAM_LFO_DEPTH_0,
+    SYNTH_PARAM_LFO_DEPTH_1,
+    SYNTH_PARAM_LFO_DEPTH_2,
+    SYNTH_PARAM_GLIDE,      // seconds a new note slides from the previous one
+    SYNTH_PARAM_DETUNE,     // cents between the outer oscillators of a unison stack
+    SYNTH_PARAM_SPREAD,     // stereo width of a unison stack, from 0 to 1
+    SYNTH_PARAMS_NUM
+};
+
+// -------------------------- +Modes --------------------------
+
+/*
+ * Poly plays a voice per note. Mono plays one voice that follows the last
+ * held note and attacks again on every note, legato only attacks when no
+ * other note was held. Glide applies in every mode.
+ */
+enum synth_VoiceMode
+{
+    SYNTH_VOICE_MODE_POLY,
+    SYNTH_VOICE_MODE_MONO,
+    SYNTH_VOICE_MODE_LEGATO
+};
+
+// -------------------------- +Governor --------------------------
+
+// Which voice makes room when the pool or a part budget is exhausted
+enum synth_StealPolicy
+{
+    SYNTH_STEAL_NONE,
+    SYNTH_STEAL_OLDEST,
+    SYNTH_STEAL_QUIETEST
+};
+
+// Every level keeps the degradations of the previous ones
+enum synth_Quality
+{
+    SYNTH_QUALITY_FULL,
+    SYNTH_QUALITY_REDUCED,  // one partial less, half the analogue saw harmonics
+    SYNTH_QUALITY_CHEAP,    // fundamental only, cheaper oscillator variants
+    SYNTH_QUALITY_STEAL     // one voice is stolen every block
+};
+
+struct synth_EngineStats
+{
+    float load;
+    enum synth_Quality quality;
+    int voices;
+    unsigned long stolen;
+    unsigned long dropped;
+    int scheduled;  // stamped events still waiting for their frame
+};
+
+// -------------------------- +Profile --------------------------
+
+// Stages the render time is split into, oscillator and envelope are part of the voices
+enum synth_Stage
+{
+    SYNTH_STAGE_EVENTS,     // queued events and parameter ramps
+    SYNTH_STAGE_VOICES,     // every part rendering its voices, oversampling included
+    SYNTH_STAGE_OSCILLATOR, // oscillators, glides and envelope ramps, sample by sample
+    SYNTH_STAGE_ENVELOPE,   // envelope stages and glides ending between chunks
+    SYNTH_STAGE_MIX,        // parts panned into the output
+    SYNTH_STAGE_OUTPUT,     // resampling to the output rate
+    SYNTH_STAGES_NUM
+};
+
+// Counted in ticks, ticksPerSecond converts them
+struct synth_ProfileStats
+{
+    unsigned long blocks;
+    unsigned long frames;
+    unsigned long voiceFrames; // frames rendered by each voice, summed
+    unsigned long missed;      // blocks the trace ring had no room for
+    uint64_t total;
+    uint64_t maxTotal;
+    uint64_t ticks[SYNTH_STAGES_NUM];
+    uint64_t maxTicks[SYNTH_STAGES_NUM];
+    uint64_t originTicks;
+    double ticksPerSecond;
+};
+
+// One internal block, stages are summed over the parts and sub-blocks
+struct synth_ProfileBlock
+{
+    uint64_t start;
+    uint64_t total;
+    uint64_t ticks[SYNTH_STAGES_NUM];
+    int frames;
+    int voiceFrames;
+};
+
+// -------------------------- +Resampler --------------------------
+
+// CPU against quality of the conversion to the output rate
+enum synth_ResamplerQuality
+{
+    SYNTH_RESAMPLER_FAST,   // 8 taps, for constrained boxes
+    SYNTH_RESAMPLER_MEDIUM, // 16 taps
+    SYNTH_RESAMPLER_BEST    // 32 taps, for offline renders
+};
+
+// -------------------------- +Engine --------------------------
+
+/*
+ * Load is the render time of a block divided by its duration, the governor
+ * lowers the quality when it crosses loadReduce, loadCheap and loadSteal.
+ *
+ * Oversampling is the initial factor of every part: voices render at that
+ * multiple of the sample rate and are decimated back, which removes most of
+ * the aliasing of square waves and LFO modulation at a proportional CPU
+ * cost. 1 keeps the fast path for live use.
+ *
+ * SampleRate is the internal rate everything renders at. When outputRate
+ * differs, the rendered frames go through a streaming resampler of the
+ * given quality, so the engine can run a low rate on constrained boxes or
+ * a high one offline and still match the device or file. 0 renders
+ * straight at sampleRate.
+ */
+struct synth_EngineConfig
+{
+    int sampleRate;
+    int outputRate;
+    enum synth_ResamplerQuality resamplerQuality;
+    int voicesNum;
+    int maxFrames;
+    int oversampling;
+    enum synth_StealPolicy stealPolicy;
+    float loadReduce;
+    float loadCheap;
+    float loadSteal;
+};
+
+/*
+ * Engine context. Every instance owns its voices, event queue and clock, so
+ * any number of engines can live in one process.
+ *
+ * The engine is multi-timbral: SYNTH_PARTS_NUM parts, MIDI channel style,
+ * each with its own patch, volume, pan and voice budget. All parts share
+ * the voice pool of voicesNum voices and render within the same block.
+ *
+ * Note and part calls may come from any thread: they only push into a
+ * lock-free event queue which the render call drains at the start of every
+ * block. Rendering itself must stay on one thread per engine.
+ */
+struct synth_Engine;
+
+void synth_engineConfigDefault(struct synth_EngineConfig *config);
+
+// All memory is allocated and touched here, rendering never allocates
+struct synth_Engine *synth_engineCreate(const struct synth_EngineConfig *config);
+void synth_engineDestroy(struct synth_Engine *engine);
+
+// Return false when the arguments are out of range or the event queue is full,
+// notes outside 0 to SYNTH_NOTE_MAX are refused
+bool synth_engineNoteOn(struct synth_Engine *engine, int part, int note);
+bool synth_engineNoteOff(struct synth_Engine *engine, int part, int note);
+// Notes stamped with a frame of synth_engineGetFrame play exactly on it, 0 or a past frame plays at once.
+// At most SYNTH_EVENTS_NUM stamped events wait at a time, more return false until the earliest play
+bool synth_engineNoteOnAt(struct synth_Engine *engine, int part, int note, uint64_t frame);
+bool synth_engineNoteOffAt(struct synth_Engine *engine, int part, int note, uint64_t frame);
+
+bool synth_engineSetPartPatch(struct synth_Engine *engine, int part, enum synth_PatchId patch);
+bool synth_engineSetPartVolume(struct synth_Engine *engine, int part, float volume);
+// From -1 (left) to +1 (right)
+bool synth_engineSetPartPan(struct synth_Engine *engine, int part, float pan);
+bool synth_engineSetPartVoices(struct synth_Engine *engine, int part, int voices);
+// Held notes are forgotten and the voices of the part released when the mode changes
+bool synth_engineSetPartMode(struct synth_Engine *engine, int part, enum synth_VoiceMode mode);
+// Oscillators per voice from 1 to SYNTH_UNISON_MAX, detuned and spread by the
+// parameters of the part. A stack shares the envelope and the LFOs of its voice
+bool synth_engineSetPartUnison(struct synth_Engine *engine, int part, int unison);
+// 1, 2, 4 or 8, active voices keep playing at the new rate
+bool synth_engineSetPartOversampling(struct synth_Engine *engine, int part, int factor);
+
+/*
+ * Parameters may be written from any thread without locks, the render
+ * thread glides to the latest value within a few milliseconds.
+ *
+ * Automation is sample accurate: the parameter ramps linearly to the value
+ * over length frames and reaches it exactly at the given frame. Frames are
+ * counted at the internal rate, see synth_engineGetFrame. A curve is a
+ * sequence of such points, they go through the event queue.
+ */
+bool synth_engineSetParam(struct synth_Engine *engine, int part, enum synth_Param param, float value);
+bool synth_engineAutomateParam(struct synth_Engine *engine, int part, enum synth_Param param, float value, uint64_t frame, int length);
+// Frames rendered at the internal rate, safe to call from any thread
+uint64_t synth_engineGetFrame(struct synth_Engine *engine);
+
+// Maps a WAV file into the engine, returns its index or -1. Blocks on file
+// access, never call it from the render thread
+int synth_engineLoadSample(struct synth_Engine *engine, const char *path);
+// The part plays the sample with the envelope and volume of its patch, -1
+// goes back to the oscillators. Voices of the part are cut when it switches
+bool synth_engineSetPartSample(struct synth_Engine *engine, int part, int sample);
+
+// Renders frames of interleaved stereo float samples at the output rate and
+// advances the clock, internally the engine renders blocks of up to maxFrames
+void synth_engineRender(struct synth_Engine *engine, float *output, int frames);
+
+// Safe to call from any thread, updated after every block
+void synth_engineGetStats(struct synth_Engine *engine, struct synth_EngineStats *stats);
+
+// Totals since the engine was created, false when the library was built
+// without SYNTH_PROFILE. Safe to call from any thread
+bool synth_engineGetProfile(struct synth_Engine *engine, struct synth_ProfileStats *stats);
+// Moves up to max of the latest blocks out for a trace, returns how many.
+// A single thread drains, blocks it does not keep up with are counted as missed
+int synth_engineDrainProfile(struct synth_Engine *engine, struct synth_ProfileBlock *blocks, int max);
+
+#endif /* SYNTH_H_ */
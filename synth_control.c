@@ -0,0 +1,169 @@
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "synth_control.h"
+#include "synth_log.h"
+
+// -------------------------- +Const --------------------------
+
+// The thread checks for shutdown at least this often
+#define       CONTROL_TIMEOUT_USEC  100000
+
+// Wait between attempts while the event queue is full
+#define       CONTROL_RETRY_NSEC    200000L
+
+#define       CONTROL_DATAGRAM_MAX  (sizeof(struct synth_ControlHeader) + SYNTH_CONTROL_BATCH_MAX * sizeof(struct synth_ControlRecord))
+
+// -------------------------- +Control --------------------------
+
+bool synth_controlIsRecordValid(const struct synth_ControlRecord *record)
+{
+    if (record->part >= SYNTH_PARTS_NUM || isnan(record->value)) {
+        return false;
+    }
+    switch (record->type) {
+        case SYNTH_CONTROL_NOTE_ON:
+        case SYNTH_CONTROL_NOTE_OFF: return record->index <= SYNTH_NOTE_MAX;
+        case SYNTH_CONTROL_PARAM: return record->index < SYNTH_PARAMS_NUM;
+        case SYNTH_CONTROL_AUTOMATE: return record->index < SYNTH_PARAMS_NUM && record->length <= INT32_MAX;
+        default: return false;
+    }
+}
+
+bool synth_controlIsBatchValid(const unsigned char *datagram, const size_t size)
+{
+    struct synth_ControlHeader header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, datagram, sizeof(header));
+    if (header.magic != SYNTH_CONTROL_MAGIC || header.version != SYNTH_CONTROL_VERSION
+            || size != sizeof(header) + header.count * sizeof(struct synth_ControlRecord)) {
+        return false;
+    }
+    for (int i = 0; i < header.count; i++) {
+        struct synth_ControlRecord record;
+        memcpy(&record, datagram + sizeof(header) + i * sizeof(record), sizeof(record));
+        if (!synth_controlIsRecordValid(&record)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Valid records only fail on a full event queue or schedule
+bool synth_controlDispatch(struct synth_Control *control, const struct synth_ControlRecord *record)
+{
+    switch (record->type) {
+        case SYNTH_CONTROL_NOTE_ON: return synth_engineNoteOnAt(control->engine, record->part, record->index, record->frame);
+        case SYNTH_CONTROL_NOTE_OFF: return synth_engineNoteOffAt(control->engine, record->part, record->index, record->frame);
+        case SYNTH_CONTROL_PARAM: return synth_engineSetParam(control->engine, record->part, record->index, record->value);
+        case SYNTH_CONTROL_AUTOMATE: return synth_engineAutomateParam(control->engine, record->part, record->index, record->value, record->frame, (int) record->length);
+    }
+    return true;
+}
+
+void synth_controlHandleBatch(struct synth_Control *control, const unsigned char *datagram, const size_t size)
+{
+    if (!synth_controlIsBatchValid(datagram, size)) {
+        atomic_fetch_add_explicit(&control->rejected, 1, memory_order_relaxed);
+        logw("Malformed control batch of %zu bytes dropped", size);
+        return;
+    }
+    const struct timespec retry = { .tv_sec = 0, .tv_nsec = CONTROL_RETRY_NSEC };
+    const int count = (int) ((size - sizeof(struct synth_ControlHeader)) / sizeof(struct synth_ControlRecord));
+    for (int i = 0; i < count; i++) {
+        struct synth_ControlRecord record;
+        memcpy(&record, datagram + sizeof(struct synth_ControlHeader) + i * sizeof(record), sizeof(record));
+        while (!synth_controlDispatch(control, &record)) {
+            if (atomic_load(&control->stopping)) {
+                return;
+            }
+            thrd_sleep(&retry, NULL);
+        }
+    }
+    atomic_fetch_add_explicit(&control->received, count, memory_order_relaxed);
+}
+
+int synth_controlThread(void *arg)
+{
+    struct synth_Control *control = arg;
+    unsigned char datagram[CONTROL_DATAGRAM_MAX];
+    while (!atomic_load(&control->stopping)) {
+        const ssize_t size = recv(control->socket, datagram, sizeof(datagram), MSG_TRUNC);
+        if (size < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                logw("Control socket failed: %s", strerror(errno));
+                break;
+            }
+            continue;
+        }
+        synth_controlHandleBatch(control, datagram, (size_t) size > sizeof(datagram) ? 0 : (size_t) size);
+    }
+    return 0;
+}
+
+bool synth_controlCreate(struct synth_Control *control, struct synth_Engine *engine, const char *path)
+{
+    assert(control != NULL);
+    assert(engine != NULL);
+    assert(path != NULL);
+    memset(control, 0, sizeof(struct synth_Control));
+    control->engine = engine;
+    control->socket = -1;
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        logw("Control socket path is too long: %s", path);
+        return false;
+    }
+    strcpy(address.sun_path, path);
+    control->socket = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if (control->socket < 0) {
+        logw("Cannot create the control socket: %s", strerror(errno));
+        return false;
+    }
+    const struct timeval timeout = { .tv_sec = 0, .tv_usec = CONTROL_TIMEOUT_USEC };
+    setsockopt(control->socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    // Only a stale socket is replaced, a mistyped path must not cost a file
+    struct stat info;
+    if (lstat(path, &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            logw("%s exists and is not a socket, not replacing it", path);
+            close(control->socket);
+            return false;
+        }
+        unlink(path);
+    }
+    if (bind(control->socket, (const struct sockaddr *) &address, sizeof(address)) != 0) {
+        logw("Cannot bind the control socket %s: %s", path, strerror(errno));
+        close(control->socket);
+        return false;
+    }
+    strcpy(control->path, path);
+    if (thrd_create(&control->thread, synth_controlThread, control) != thrd_success) {
+        logw("Cannot start the control thread");
+        close(control->socket);
+        unlink(control->path);
+        return false;
+    }
+    logi("Control socket listens at %s", path);
+    return true;
+}
+
+void synth_controlDestroy(struct synth_Control *control)
+{
+    assert(control != NULL);
+    atomic_store(&control->stopping, true);
+    thrd_join(control->thread, NULL);
+    close(control->socket);
+    unlink(control->path);
+    logi("Control socket closed, %lu records, %lu batches rejected", atomic_load(&control->received), atomic_load(&control->rejected));
+}
@@ -0,0 +1,82 @@
+#ifndef SYNTH_CONTROL_H_
+#define SYNTH_CONTROL_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "c11threads.h"
+
+#include "synth.h"
+
+// -------------------------- +Protocol --------------------------
+
+/*
+ * Local control surface: one Unix datagram socket per engine. Every
+ * datagram is a batch, a header followed by count records, in the native
+ * byte order of the machine. Malformed batches are dropped as a whole.
+ *
+ * Frames are those of synth_engineGetFrame. A note or automation point
+ * stamped 0 or in the past plays at once, later ones land exactly on
+ * their frame.
+ */
+
+#define       SYNTH_CONTROL_MAGIC   0x53594E54u  // "SYNT"
+#define       SYNTH_CONTROL_VERSION 1
+#define       SYNTH_CONTROL_BATCH_MAX 256
+
+enum synth_ControlType
+{
+    SYNTH_CONTROL_NOTE_ON = 1,  // index is the note, up to SYNTH_NOTE_MAX
+    SYNTH_CONTROL_NOTE_OFF,
+    SYNTH_CONTROL_PARAM,        // index is the parameter, glides to value, frame is ignored
+    SYNTH_CONTROL_AUTOMATE      // index is the parameter, reaches value at frame over length frames
+};
+
+struct synth_ControlHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t count;
+};
+
+struct synth_ControlRecord
+{
+    uint8_t type;
+    uint8_t part;
+    uint16_t index;
+    float value;
+    uint64_t frame;
+    uint32_t length;
+    uint32_t reserved;
+};
+
+_Static_assert(sizeof(struct synth_ControlHeader) == 8, "The header is part of the protocol");
+_Static_assert(sizeof(struct synth_ControlRecord) == 24, "Records are part of the protocol");
+
+// -------------------------- +Control --------------------------
+
+/*
+ * The socket is serviced by its own thread, never by the render thread.
+ * Records go into the event queue of the engine, a full queue makes the
+ * thread wait for the render thread to drain it, so a burst backs up into
+ * the socket buffer instead of losing notes. The same goes for records
+ * stamped ahead once the engine holds SYNTH_EVENTS_NUM of them, the thread
+ * waits for the earliest to play while live input keeps flowing.
+ */
+struct synth_Control
+{
+    struct synth_Engine *engine;
+    int socket;
+    char path[108];
+    thrd_t thread;
+    atomic_bool stopping;
+    atomic_ulong received;
+    atomic_ulong rejected;
+};
+
+// Binds the socket at path, replacing a stale one, and starts the thread
+bool synth_controlCreate(struct synth_Control *control, struct synth_Engine *engine, const char *path);
+void synth_controlDestroy(struct synth_Control *control);
+
+#endif /* SYNTH_CONTROL_H_ */
@@ -0,0 +1,123 @@
+#include <assert.h>
+#include <string.h>
+
+#include "synth_converter.h"
+
+// -------------------------- +Const --------------------------
+
+// Samples quantized at a time, a multiple of the lanes
+#define       CONVERTER_CHUNK       256
+
+_Static_assert(CONVERTER_CHUNK % SYNTH_CONVERTER_LANES == 0, "Chunks are whole groups of lanes");
+
+// -------------------------- +Converter --------------------------
+
+const float   g_converterSilence[CONVERTER_CHUNK] = { 0.0f };
+
+void synth_converterInit(struct synth_Converter *converter, const enum synth_OutputFormat format, const bool dither)
+{
+    assert(converter != NULL);
+    converter->format = format;
+    converter->dither = dither && format != SYNTH_OUTPUT_F32 && format != SYNTH_OUTPUT_S32;
+    for (int l = 0; l < SYNTH_CONVERTER_LANES; l++) {
+        converter->state[l] = 0x9E3779B9u * (uint32_t) (l + 1);
+    }
+}
+
+int synth_converterSampleSize(const enum synth_OutputFormat format)
+{
+    switch (format) {
+        case SYNTH_OUTPUT_S16: return 2;
+        case SYNTH_OUTPUT_S24: return 3;
+        case SYNTH_OUTPUT_F32:
+        case SYNTH_OUTPUT_S32: return 4;
+    }
+    return 4;
+}
+
+extern inline uint32_t synth_converterXorshift(uint32_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// Sum of two uniform values, from -1 to +1 LSB with a peak at 0
+void synth_converterNoise(struct synth_Converter *converter, float *restrict noise, const int samples)
+{
+    uint32_t *restrict state = converter->state;
+    for (int i = 0; i < samples; i += SYNTH_CONVERTER_LANES) {
+        for (int l = 0; l < SYNTH_CONVERTER_LANES; l++) {
+            const uint32_t first = synth_converterXorshift(state[l]);
+            const uint32_t second = synth_converterXorshift(first);
+            state[l] = second;
+            const float sum = (float) (int32_t) (first >> 8) + (float) (int32_t) (second >> 8);
+            noise[i + l] = sum * (1.0f / 16777216.0f) - 1.0f;
+        }
+    }
+}
+
+// The high bound is the largest float that still fits the format
+void synth_converterQuantize(const float *restrict input, const float *restrict noise, int32_t *restrict output, const int samples, const float scale, const float high)
+{
+    const float low = -scale;
+    for (int i = 0; i < samples; i++) {
+        float value = input[i] * scale + noise[i];
+        value = value < low ? low : value;
+        value = value > high ? high : value;
+        output[i] = (int32_t) (value + (value >= 0.0f ? 0.5f : -0.5f));
+    }
+}
+
+void synth_converterProcess(struct synth_Converter *converter, const float *input, void *output, const int samples)
+{
+    assert(converter != NULL);
+    assert(input != NULL);
+    assert(output != NULL);
+    if (converter->format == SYNTH_OUTPUT_F32) {
+        memcpy(output, input, samples * sizeof(float));
+        return;
+    }
+    float noise[CONVERTER_CHUNK];
+    int32_t quantized[CONVERTER_CHUNK];
+    unsigned char *bytes = output;
+    for (int done = 0; done < samples; done += CONVERTER_CHUNK) {
+        const int chunk = samples - done < CONVERTER_CHUNK ? samples - done : CONVERTER_CHUNK;
+        const float *dither = g_converterSilence;
+        if (converter->dither) {
+            synth_converterNoise(converter, noise, chunk);
+            dither = noise;
+        }
+        switch (converter->format) {
+            case SYNTH_OUTPUT_S16:
+            {
+                synth_converterQuantize(input + done, dither, quantized, chunk, 32768.0f, 32767.0f);
+                int16_t *restrict target = (int16_t *) bytes + done;
+                for (int i = 0; i < chunk; i++) {
+                    target[i] = (int16_t) quantized[i];
+                }
+                break;
+            }
+            case SYNTH_OUTPUT_S24:
+            {
+                synth_converterQuantize(input + done, dither, quantized, chunk, 8388608.0f, 8388607.0f);
+                unsigned char *target = bytes + (size_t) done * 3;
+                for (int i = 0; i < chunk; i++) {
+                    const uint32_t value = (uint32_t) quantized[i];
+                    target[3 * i + 0] = (unsigned char) value;
+                    target[3 * i + 1] = (unsigned char) (value >> 8);
+                    target[3 * i + 2] = (unsigned char) (value >> 16);
+                }
+                break;
+            }
+            case SYNTH_OUTPUT_S32:
+            {
+                synth_converterQuantize(input + done, dither, (int32_t *) bytes + done, chunk, 2147483648.0f, 2147483520.0f);
+                break;
+            }
+            case SYNTH_OUTPUT_F32:
+                break;
+        }
+    }
+}
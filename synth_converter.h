@@ -0,0 +1,48 @@
+#ifndef SYNTH_CONVERTER_H_
+#define SYNTH_CONVERTER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// -------------------------- +Const --------------------------
+
+// Dither generators run side by side, one per lane
+#define       SYNTH_CONVERTER_LANES 8
+
+// -------------------------- +Converter --------------------------
+
+enum synth_OutputFormat
+{
+    SYNTH_OUTPUT_F32,
+    SYNTH_OUTPUT_S16,
+    SYNTH_OUTPUT_S24,   // packed in 3 bytes, little endian
+    SYNTH_OUTPUT_S32
+};
+
+/*
+ * Turns the float output of the engine into the format of the device or
+ * file. Samples are scaled to full scale, clamped and rounded to nearest in
+ * chunks, every step picks between constants so the loops vectorize.
+ *
+ * With dither on, triangular noise of one LSB peak is added before
+ * rounding, so the quantization error is noise instead of distortion of
+ * quiet passages. Each lane runs its own xorshift generator. S32 is never
+ * dithered, a float has fewer bits than the format.
+ */
+struct synth_Converter
+{
+    enum synth_OutputFormat format;
+    bool dither;
+    uint32_t state[SYNTH_CONVERTER_LANES];
+};
+
+void synth_converterInit(struct synth_Converter *converter, enum synth_OutputFormat format, bool dither);
+
+// Bytes of one sample of the format
+int synth_converterSampleSize(enum synth_OutputFormat format);
+
+// Interleaved samples, the output takes samples * synth_converterSampleSize() bytes
+// and is aligned for a float, S16 and S32 are written as integers of their size
+void synth_converterProcess(struct synth_Converter *converter, const float *input, void *output, int samples);
+
+#endif /* SYNTH_CONVERTER_H_ */
@@ -0,0 +1,117 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "synth_fft.h"
+
+// -------------------------- +Const --------------------------
+
+#define       FFT_ALIGN             64
+
+// -------------------------- +Fft --------------------------
+
+size_t synth_fftAligned(const size_t bytes)
+{
+    return ((bytes + FFT_ALIGN - 1) / FFT_ALIGN) * FFT_ALIGN;
+}
+
+bool synth_fftCreate(struct synth_Fft *fft, const int size)
+{
+    assert(fft != NULL);
+    assert(size >= 4 && (size & (size - 1)) == 0);
+    memset(fft, 0, sizeof(struct synth_Fft));
+    fft->size = size;
+    const int half = size / 2;
+    const size_t tableSize = synth_fftAligned((half + 1) * sizeof(float));
+    const size_t reverseSize = synth_fftAligned(half * sizeof(int));
+    const size_t workSize = synth_fftAligned(half * sizeof(float));
+    fft->memory = aligned_alloc(FFT_ALIGN, 2 * tableSize + reverseSize + 2 * workSize);
+    if (fft->memory == NULL) {
+        return false;
+    }
+    char *memory = fft->memory;
+    fft->cosines = (float *) memory; memory += tableSize;
+    fft->sines = (float *) memory; memory += tableSize;
+    fft->reverse = (int *) memory; memory += reverseSize;
+    fft->re = (float *) memory; memory += workSize;
+    fft->im = (float *) memory; memory += workSize;
+    for (int k = 0; k <= half; k++) {
+        const double angle = 2.0 * M_PI * k / size;
+        fft->cosines[k] = (float) cos(angle);
+        fft->sines[k] = (float) sin(angle);
+    }
+    int bits = 0;
+    while ((1 << bits) < half) {
+        bits++;
+    }
+    for (int i = 0; i < half; i++) {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        fft->reverse[i] = reversed;
+    }
+    return true;
+}
+
+void synth_fftDestroy(struct synth_Fft *fft)
+{
+    assert(fft != NULL);
+    free(fft->memory);
+    memset(fft, 0, sizeof(struct synth_Fft));
+}
+
+// In place over the work arrays, twiddles of length len are every size / len entry
+void synth_fftComplex(struct synth_Fft *fft)
+{
+    const int half = fft->size / 2;
+    float *restrict re = fft->re;
+    float *restrict im = fft->im;
+    for (int len = 2; len <= half; len <<= 1) {
+        const int step = fft->size / len;
+        for (int i = 0; i < half; i += len) {
+            for (int j = 0; j < len / 2; j++) {
+                const float wr = fft->cosines[j * step];
+                const float wi = -fft->sines[j * step];
+                const int a = i + j;
+                const int b = a + len / 2;
+                const float tr = re[b] * wr - im[b] * wi;
+                const float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+    }
+}
+
+/*
+ * Even samples go to the real and odd ones to the imaginary part. With Z
+ * the transform of that sequence and N the real size:
+ * X[k] = (Z[k] + Z*[N/2 - k]) / 2 - i e^(-2 pi i k / N) (Z[k] - Z*[N/2 - k]) / 2
+ */
+void synth_fftReal(struct synth_Fft *fft, const float *input, float *re, float *im)
+{
+    assert(fft != NULL);
+    const int half = fft->size / 2;
+    for (int i = 0; i < half; i++) {
+        const int target = fft->reverse[i];
+        fft->re[target] = input[2 * i + 0];
+        fft->im[target] = input[2 * i + 1];
+    }
+    synth_fftComplex(fft);
+    for (int k = 0; k <= half; k++) {
+        const int a = k % half;
+        const int b = (half - k) % half;
+        const float evenRe = 0.5f * (fft->re[a] + fft->re[b]);
+        const float evenIm = 0.5f * (fft->im[a] - fft->im[b]);
+        const float oddRe = 0.5f * (fft->im[a] + fft->im[b]);
+        const float oddIm = -0.5f * (fft->re[a] - fft->re[b]);
+        const float wr = fft->cosines[k];
+        const float wi = -fft->sines[k];
+        re[k] = evenRe + wr * oddRe - wi * oddIm;
+        im[k] = evenIm + wr * oddIm + wi * oddRe;
+    }
+}
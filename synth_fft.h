@@ -0,0 +1,33 @@
+#ifndef SYNTH_FFT_H_
+#define SYNTH_FFT_H_
+
+#include <stdbool.h>
+
+// -------------------------- +Fft --------------------------
+
+/*
+ * Forward FFT of real input. The size real samples are packed into a
+ * complex sequence of half the size, transformed with an iterative radix-2
+ * FFT and split into the spectrum afterwards, so a real transform costs
+ * about half of a complex one. Twiddles and the bit reversal are tabulated
+ * when the transform is created.
+ */
+struct synth_Fft
+{
+    int size;
+    float *cosines;     // size / 2 + 1 entries of cos(2 pi k / size)
+    float *sines;
+    int *reverse;       // bit reversal of the complex half size
+    float *re;
+    float *im;
+    void *memory;
+};
+
+// Size is a power of two, at least 4
+bool synth_fftCreate(struct synth_Fft *fft, int size);
+void synth_fftDestroy(struct synth_Fft *fft);
+
+// Bins 0 to size / 2 of the spectrum, unnormalized
+void synth_fftReal(struct synth_Fft *fft, const float *input, float *re, float *im);
+
+#endif /* SYNTH_FFT_H_ */
@@ -0,0 +1,240 @@
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "c11threads.h"
+
+#include "synth_log.h"
+
+// -------------------------- +Const --------------------------
+
+#define       LOG_RECORDS_MASK      (LOG_RECORDS_NUM - 1)
+
+#define       LOG_DRAIN_PERIOD      10000000L
+
+const char    *g_logLevelNames[]    = { "DEBUG", "INFO", "WARNING", "ERROR" };
+
+// -------------------------- +Rings --------------------------
+
+struct synth_LogRecord
+{
+    float time;
+    enum synth_LogLevel level;
+    const char *file;
+    int line;
+    char text[LOG_TEXT_SIZE];
+};
+
+// Single producer (the owning thread) / single consumer (the drain thread)
+struct synth_LogRing
+{
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+    atomic_ulong dropped;
+    atomic_bool owned;
+    struct synth_LogRecord records[LOG_RECORDS_NUM];
+};
+
+struct synth_LogRing g_logRings[LOG_RINGS_NUM];
+
+atomic_ulong  g_logDroppedThreads;
+
+_Thread_local struct synth_LogRing *t_logRing = NULL;
+
+once_flag     g_logOnce             = ONCE_FLAG_INIT;
+tss_t         g_logRingKey;
+struct timespec g_logStart;
+
+atomic_bool   g_logRunning          = false;
+atomic_bool   g_logStopping         = false;
+atomic_int    g_logWriters          = 0;
+thrd_t        g_logThread;
+mtx_t         g_logDrainLock;
+
+void synth_logRingRelease(void *ring)
+{
+    atomic_store_explicit(&((struct synth_LogRing *) ring)->owned, false, memory_order_release);
+}
+
+void synth_logInit()
+{
+    clock_gettime(CLOCK_MONOTONIC, &g_logStart);
+    tss_create(&g_logRingKey, synth_logRingRelease);
+    mtx_init(&g_logDrainLock, mtx_plain);
+}
+
+// Rings go back to the pool when their thread exits, queued records stay
+struct synth_LogRing *synth_logRingAcquire()
+{
+    if (t_logRing != NULL) {
+        return t_logRing;
+    }
+    for (int i = 0; i < LOG_RINGS_NUM; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&g_logRings[i].owned, &expected, true)) {
+            t_logRing = &g_logRings[i];
+            tss_set(g_logRingKey, t_logRing);
+            return t_logRing;
+        }
+    }
+    return NULL;
+}
+
+bool synth_logRingPush(struct synth_LogRing *ring, const struct synth_LogRecord *record)
+{
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail - head >= LOG_RECORDS_NUM) {
+        atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    ring->records[tail & LOG_RECORDS_MASK] = *record;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+struct synth_LogRecord *synth_logRingPeek(struct synth_LogRing *ring)
+{
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head == tail) {
+        return NULL;
+    }
+    return &ring->records[head & LOG_RECORDS_MASK];
+}
+
+void synth_logRingPop(struct synth_LogRing *ring)
+{
+    const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+// -------------------------- +Drain --------------------------
+
+void synth_logPrint(const struct synth_LogRecord *record)
+{
+    printf("%.2f -> %s -> %s:%d %s\n", record->time, g_logLevelNames[record->level], record->file, record->line, record->text);
+}
+
+void synth_logReportDropped()
+{
+    for (int i = 0; i < LOG_RINGS_NUM; i++) {
+        const unsigned long dropped = atomic_exchange_explicit(&g_logRings[i].dropped, 0, memory_order_relaxed);
+        if (dropped > 0) {
+            printf("%.2f -> WARNING -> %lu log records dropped by ring %d\n", synth_logGetTime(), dropped, i);
+        }
+    }
+    const unsigned long threads = atomic_exchange_explicit(&g_logDroppedThreads, 0, memory_order_relaxed);
+    if (threads > 0) {
+        printf("%.2f -> WARNING -> %lu log records dropped, no free rings\n", synth_logGetTime(), threads);
+    }
+}
+
+// Merges the rings by timestamp, oldest record first. Errors drain from their
+// own thread, the lock keeps a single consumer on the rings
+void synth_logDrain()
+{
+    mtx_lock(&g_logDrainLock);
+    for (;;) {
+        struct synth_LogRing *oldest = NULL;
+        struct synth_LogRecord *oldestRecord = NULL;
+        for (int i = 0; i < LOG_RINGS_NUM; i++) {
+            struct synth_LogRecord *record = synth_logRingPeek(&g_logRings[i]);
+            if (record != NULL && (oldestRecord == NULL || record->time < oldestRecord->time)) {
+                oldest = &g_logRings[i];
+                oldestRecord = record;
+            }
+        }
+        if (oldest == NULL) {
+            break;
+        }
+        synth_logPrint(oldestRecord);
+        synth_logRingPop(oldest);
+    }
+    synth_logReportDropped();
+    fflush(stdout);
+    mtx_unlock(&g_logDrainLock);
+}
+
+int synth_logThread(void *arg)
+{
+    (void) arg;
+    const struct timespec period = { .tv_sec = 0, .tv_nsec = LOG_DRAIN_PERIOD };
+    while (!atomic_load(&g_logStopping)) {
+        synth_logDrain();
+        thrd_sleep(&period, NULL);
+    }
+    synth_logDrain();
+    return 0;
+}
+
+// -------------------------- +Log --------------------------
+
+float synth_logGetTime()
+{
+    call_once(&g_logOnce, synth_logInit);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (float) (now.tv_sec - g_logStart.tv_sec) + (float) (now.tv_nsec - g_logStart.tv_nsec) / 1e+9f;
+}
+
+void synth_logStart()
+{
+    call_once(&g_logOnce, synth_logInit);
+    if (atomic_load(&g_logRunning)) {
+        return;
+    }
+    atomic_store(&g_logStopping, false);
+    if (thrd_create(&g_logThread, synth_logThread, NULL) != thrd_success) {
+        printf("%.2f -> WARNING -> cannot start the log thread, logging stays synchronous\n", synth_logGetTime());
+        return;
+    }
+    atomic_store(&g_logRunning, true);
+}
+
+// Writers that saw the logger running finish their push before the final drain
+void synth_logStop()
+{
+    if (!atomic_exchange(&g_logRunning, false)) {
+        return;
+    }
+    while (atomic_load(&g_logWriters) > 0) {
+        thrd_yield();
+    }
+    atomic_store(&g_logStopping, true);
+    thrd_join(g_logThread, NULL);
+}
+
+void logline(const enum synth_LogLevel level, const char *file, int line, const char *fmt, ...)
+{
+    struct synth_LogRecord record;
+    record.time = synth_logGetTime();
+    record.level = level;
+    record.file = file;
+    record.line = line;
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(record.text, sizeof(record.text), fmt, args);
+    va_end(args);
+    if (level == LOG_LEVEL_ERROR) {
+        synth_logDrain();
+        synth_logPrint(&record);
+        fflush(stdout);
+        exit(-1);
+    }
+    atomic_fetch_add(&g_logWriters, 1);
+    if (!atomic_load(&g_logRunning)) {
+        atomic_fetch_sub(&g_logWriters, 1);
+        synth_logPrint(&record);
+        return;
+    }
+    struct synth_LogRing *ring = synth_logRingAcquire();
+    if (ring == NULL) {
+        atomic_fetch_add_explicit(&g_logDroppedThreads, 1, memory_order_relaxed);
+    } else {
+        synth_logRingPush(ring, &record);
+    }
+    atomic_fetch_sub(&g_logWriters, 1);
+}
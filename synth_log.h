@@ -0,0 +1,52 @@
+#ifndef SYNTH_LOG_H_
+#define SYNTH_LOG_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// -------------------------- +Log --------------------------
+
+/*
+ * Asynchronous logger. Every thread formats into its own lock-free ring of
+ * fixed size records, a background thread merges the rings by time and
+ * prints them. A full ring drops the record and counts it, so logging never
+ * blocks the caller. Memory is bounded: LOG_RINGS_NUM rings of
+ * LOG_RECORDS_NUM records, threads above that count are dropped as well.
+ *
+ * Until synth_logStart() is called, or after synth_logStop(), lines are
+ * printed synchronously by the caller.
+ *
+ * Errors flush everything that is queued and terminate the process.
+ */
+
+enum synth_LogLevel
+{
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_ERROR
+};
+
+// Levels below this one are compiled out together with their arguments
+#ifndef SYNTH_LOG_LEVEL
+#define       SYNTH_LOG_LEVEL       LOG_LEVEL_INFO
+#endif
+
+#define       LOG_RINGS_NUM         32
+#define       LOG_RECORDS_NUM       64
+#define       LOG_TEXT_SIZE         200
+
+// Seconds since the logger was first used, used to timestamp log lines
+float synth_logGetTime();
+
+void synth_logStart();
+void synth_logStop();
+
+void logline(enum synth_LogLevel level, const char *file, int line, const char *fmt, ...);
+
+#define logd(...) { if (LOG_LEVEL_DEBUG >= SYNTH_LOG_LEVEL) logline(LOG_LEVEL_DEBUG, __FILE__, __LINE__, __VA_ARGS__); }
+#define logi(...) { if (LOG_LEVEL_INFO >= SYNTH_LOG_LEVEL) logline(LOG_LEVEL_INFO, __FILE__, __LINE__, __VA_ARGS__); }
+#define logw(...) { if (LOG_LEVEL_WARNING >= SYNTH_LOG_LEVEL) logline(LOG_LEVEL_WARNING, __FILE__, __LINE__, __VA_ARGS__); }
+#define loge(...) { logline(LOG_LEVEL_ERROR, __FILE__, __LINE__, __VA_ARGS__); }
+
+#endif /* SYNTH_LOG_H_ */
@@ -0,0 +1,163 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "c11threads.h"
+
+#include "synth_oversampler.h"
+
+// -------------------------- +Const --------------------------
+
+#define       PI                    ((float) M_PI)
+
+#define       OVERSAMPLER_ALIGN     64
+
+// -------------------------- +Half-band --------------------------
+
+// Blackman windowed sinc, the non-zero odd taps only, scaled for unity gain at DC
+void synth_halfBandDesign(float *coeffs, const int pairs)
+{
+    const float halfWidth = 2.0f * pairs;
+    float sum = 0.0f;
+    for (int k = 1; k <= pairs; k++) {
+        const float tap = 2.0f * k - 1.0f;
+        const float sinc = sinf(PI * tap / 2.0f) / (PI * tap / 2.0f);
+        const float window = 0.42f + 0.5f * cosf(PI * tap / halfWidth) + 0.08f * cosf(2.0f * PI * tap / halfWidth);
+        coeffs[k - 1] = 0.5f * sinc * window;
+        sum += coeffs[k - 1];
+    }
+    for (int k = 0; k < pairs; k++) {
+        coeffs[k] *= 0.25f / sum;
+    }
+}
+
+// Every oversampler uses the same coefficients, they are designed once per process
+float g_halfBandFinal[HALFBAND_PAIRS_FINAL];
+float g_halfBandEarly[HALFBAND_PAIRS_EARLY];
+once_flag g_halfBandOnce = ONCE_FLAG_INIT;
+
+void synth_halfBandDesignShared(void)
+{
+    synth_halfBandDesign(g_halfBandFinal, HALFBAND_PAIRS_FINAL);
+    synth_halfBandDesign(g_halfBandEarly, HALFBAND_PAIRS_EARLY);
+}
+
+/*
+ * y[n] = x[2n - D] / 2 + sum c[k] * (x[2n - D - (2k - 1)] + x[2n - D + (2k - 1)])
+ * with the delay D = 2 * pairs - 1 keeping it causal. The middle tap lands on
+ * odd samples and all the others on even ones.
+ */
+void synth_halfBandProcess(struct synth_HalfBand *stage, const float *input, float *output, const int frames)
+{
+    const int pairs = stage->pairs;
+    const int evenHistory = 2 * pairs - 1;
+    float *restrict even = stage->even;
+    float *restrict odd = stage->odd;
+    for (int n = 0; n < frames; n++) {
+        even[evenHistory + n] = input[2 * n + 0];
+        odd[pairs + n] = input[2 * n + 1];
+    }
+    for (int n = 0; n < frames; n++) {
+        output[n] = 0.5f * odd[n];
+    }
+    for (int k = 1; k <= pairs; k++) {
+        const float coeff = stage->coeffs[k - 1];
+        const float *restrict late = even + pairs + k - 1;
+        const float *restrict early = even + pairs - k;
+        for (int n = 0; n < frames; n++) {
+            output[n] += coeff * (late[n] + early[n]);
+        }
+    }
+    memmove(even, even + frames, evenHistory * sizeof(float));
+    memmove(odd, odd + frames, pairs * sizeof(float));
+}
+
+// -------------------------- +Oversampler --------------------------
+
+bool synth_oversamplerIsFactorValid(const int factor)
+{
+    return factor == 1 || factor == 2 || factor == 4 || factor == 8;
+}
+
+// Stage i never outputs more than maxFrames * SYNTH_OVERSAMPLING_MAX / 2^(i + 1) samples
+size_t synth_oversamplerStageSize(const int stage, const int maxFrames, const int history)
+{
+    const size_t samples = history + (size_t) maxFrames * (SYNTH_OVERSAMPLING_MAX >> (stage + 1));
+    return ((samples * sizeof(float) + OVERSAMPLER_ALIGN - 1) / OVERSAMPLER_ALIGN) * OVERSAMPLER_ALIGN;
+}
+
+bool synth_oversamplerCreate(struct synth_Oversampler *oversampler, const int factor, const int maxFrames)
+{
+    assert(oversampler != NULL);
+    assert(synth_oversamplerIsFactorValid(factor));
+    memset(oversampler, 0, sizeof(struct synth_Oversampler));
+    const int evenHistory = 2 * HALFBAND_PAIRS_FINAL - 1;
+    size_t size = 0;
+    for (int i = 0; i < OVERSAMPLER_STAGES_MAX; i++) {
+        size += synth_oversamplerStageSize(i, maxFrames, evenHistory) + synth_oversamplerStageSize(i, maxFrames, HALFBAND_PAIRS_FINAL);
+    }
+    oversampler->memory = aligned_alloc(OVERSAMPLER_ALIGN, size);
+    if (oversampler->memory == NULL) {
+        return false;
+    }
+    memset(oversampler->memory, 0, size);
+    char *memory = oversampler->memory;
+    for (int i = 0; i < OVERSAMPLER_STAGES_MAX; i++) {
+        oversampler->stages[i].even = (float *) memory;
+        memory += synth_oversamplerStageSize(i, maxFrames, evenHistory);
+        oversampler->stages[i].odd = (float *) memory;
+        memory += synth_oversamplerStageSize(i, maxFrames, HALFBAND_PAIRS_FINAL);
+    }
+    call_once(&g_halfBandOnce, synth_halfBandDesignShared);
+    synth_oversamplerSetFactor(oversampler, factor);
+    return true;
+}
+
+void synth_oversamplerDestroy(struct synth_Oversampler *oversampler)
+{
+    assert(oversampler != NULL);
+    free(oversampler->memory);
+    memset(oversampler, 0, sizeof(struct synth_Oversampler));
+}
+
+void synth_oversamplerSetFactor(struct synth_Oversampler *oversampler, const int factor)
+{
+    assert(synth_oversamplerIsFactorValid(factor));
+    oversampler->factor = factor;
+    oversampler->stagesNum = 0;
+    while ((1 << oversampler->stagesNum) < factor) {
+        oversampler->stagesNum++;
+    }
+    for (int i = 0; i < oversampler->stagesNum; i++) {
+        struct synth_HalfBand *stage = &oversampler->stages[i];
+        const bool last = i == oversampler->stagesNum - 1;
+        stage->pairs = last ? HALFBAND_PAIRS_FINAL : HALFBAND_PAIRS_EARLY;
+        stage->coeffs = last ? g_halfBandFinal : g_halfBandEarly;
+    }
+    synth_oversamplerReset(oversampler);
+}
+
+void synth_oversamplerReset(struct synth_Oversampler *oversampler)
+{
+    for (int i = 0; i < oversampler->stagesNum; i++) {
+        struct synth_HalfBand *stage = &oversampler->stages[i];
+        memset(stage->even, 0, (2 * stage->pairs - 1) * sizeof(float));
+        memset(stage->odd, 0, stage->pairs * sizeof(float));
+    }
+}
+
+void synth_oversamplerProcess(struct synth_Oversampler *oversampler, float *input, float *output, const int frames)
+{
+    assert(oversampler != NULL);
+    if (oversampler->stagesNum == 0) {
+        memcpy(output, input, frames * sizeof(float));
+        return;
+    }
+    int length = frames * oversampler->factor;
+    for (int i = 0; i < oversampler->stagesNum; i++) {
+        length /= 2;
+        float *target = i == oversampler->stagesNum - 1 ? output : input;
+        synth_halfBandProcess(&oversampler->stages[i], input, target, length);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef SYNTH_OVERSAMPLER_H_
+#define SYNTH_OVERSAMPLER_H_
+
+#include <stdbool.h>
+
+#include "synth.h"
+
+// -------------------------- +Const --------------------------
+
+// Half-band stages for the largest factor, every stage halves the rate
+#define       OVERSAMPLER_STAGES_MAX 3
+
+// Symmetric coefficient pairs of the last stage and of the stages above it
+#define       HALFBAND_PAIRS_FINAL  16
+#define       HALFBAND_PAIRS_EARLY  6
+
+// -------------------------- +Half-band --------------------------
+
+/*
+ * Polyphase half-band decimator by 2. Every other coefficient of a half-band
+ * filter is zero and the middle one is 1/2, so the block is split into its
+ * even and odd samples: the odd phase is only delayed, the even phase goes
+ * through a short symmetric filter. Both loops run over the whole block
+ * with contiguous reads and vectorize.
+ */
+struct synth_HalfBand
+{
+    int pairs;
+    const float *coeffs;
+    float *even;    // 2 * pairs - 1 samples of history, then the block
+    float *odd;     // pairs samples of history, then the block
+};
+
+// -------------------------- +Oversampler --------------------------
+
+/*
+ * Cascade of half-band decimators bringing a block rendered at 2x, 4x or
+ * 8x down to the output rate. Stages above the last one only have to stop
+ * what would fold into the audible band, so they are shorter.
+ */
+struct synth_Oversampler
+{
+    int factor;
+    int stagesNum;
+    struct synth_HalfBand stages[OVERSAMPLER_STAGES_MAX];
+    void *memory;
+};
+
+bool synth_oversamplerIsFactorValid(int factor);
+
+// Work buffers are sized for SYNTH_OVERSAMPLING_MAX, changing the factor never allocates
+bool synth_oversamplerCreate(struct synth_Oversampler *oversampler, int factor, int maxFrames);
+void synth_oversamplerDestroy(struct synth_Oversampler *oversampler);
+
+void synth_oversamplerSetFactor(struct synth_Oversampler *oversampler, int factor);
+// Clears the filter history
+void synth_oversamplerReset(struct synth_Oversampler *oversampler);
+
+// Decimates factor * frames input samples into frames output samples, the input is clobbered
+void synth_oversamplerProcess(struct synth_Oversampler *oversampler, float *input, float *output, int frames);
+
+#endif /* SYNTH_OVERSAMPLER_H_ */
@@ -0,0 +1,115 @@
+#include <assert.h>
+#include <string.h>
+
+#include "synth_profile.h"
+
+// -------------------------- +Const --------------------------
+
+#define       PROFILE_MASK          (PROFILE_BLOCKS_NUM - 1)
+
+// -------------------------- +Profile --------------------------
+
+double synth_profileGetClock()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) now.tv_sec + (double) now.tv_nsec / 1e+9;
+}
+
+void synth_profileInit(struct synth_Profile *profile)
+{
+    assert(profile != NULL);
+    memset(&profile->block, 0, sizeof(profile->block));
+    memset(&profile->totals, 0, sizeof(profile->totals));
+    atomic_init(&profile->blocks, 0);
+    atomic_init(&profile->frames, 0);
+    atomic_init(&profile->voiceFrames, 0);
+    atomic_init(&profile->total, 0);
+    atomic_init(&profile->maxTotal, 0);
+    for (int s = 0; s < SYNTH_STAGES_NUM; s++) {
+        atomic_init(&profile->ticks[s], 0);
+        atomic_init(&profile->maxTicks[s], 0);
+    }
+    atomic_init(&profile->head, 0);
+    atomic_init(&profile->tail, 0);
+    atomic_init(&profile->missed, 0);
+    profile->originClock = synth_profileGetClock();
+    profile->originTicks = synth_profileTicks();
+}
+
+// Stages marked between blocks, the output of the previous one, stay with the next block
+void synth_profileBeginBlock(struct synth_Profile *profile)
+{
+    profile->block.start = synth_profileTicks();
+}
+
+void synth_profileEndBlock(struct synth_Profile *profile, const int frames)
+{
+    struct synth_ProfileBlock *block = &profile->block;
+    struct synth_ProfileStats *totals = &profile->totals;
+    block->total = synth_profileTicks() - block->start;
+    block->frames = frames;
+    totals->blocks++;
+    totals->frames += frames;
+    totals->voiceFrames += block->voiceFrames;
+    totals->total += block->total;
+    totals->maxTotal = block->total > totals->maxTotal ? block->total : totals->maxTotal;
+    for (int s = 0; s < SYNTH_STAGES_NUM; s++) {
+        totals->ticks[s] += block->ticks[s];
+        totals->maxTicks[s] = block->ticks[s] > totals->maxTicks[s] ? block->ticks[s] : totals->maxTicks[s];
+        atomic_store_explicit(&profile->ticks[s], totals->ticks[s], memory_order_relaxed);
+        atomic_store_explicit(&profile->maxTicks[s], totals->maxTicks[s], memory_order_relaxed);
+    }
+    atomic_store_explicit(&profile->total, totals->total, memory_order_relaxed);
+    atomic_store_explicit(&profile->maxTotal, totals->maxTotal, memory_order_relaxed);
+    atomic_store_explicit(&profile->voiceFrames, totals->voiceFrames, memory_order_relaxed);
+    atomic_store_explicit(&profile->frames, totals->frames, memory_order_relaxed);
+    atomic_store_explicit(&profile->blocks, totals->blocks, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&profile->head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&profile->tail, memory_order_acquire);
+    if (head - tail < PROFILE_BLOCKS_NUM) {
+        profile->records[head & PROFILE_MASK] = *block;
+        atomic_store_explicit(&profile->head, head + 1, memory_order_release);
+    } else {
+        atomic_fetch_add_explicit(&profile->missed, 1, memory_order_relaxed);
+    }
+    memset(block, 0, sizeof(struct synth_ProfileBlock));
+}
+
+void synth_profileGet(struct synth_Profile *profile, struct synth_ProfileStats *stats)
+{
+    assert(profile != NULL);
+    assert(stats != NULL);
+    stats->blocks = atomic_load_explicit(&profile->blocks, memory_order_relaxed);
+    stats->frames = atomic_load_explicit(&profile->frames, memory_order_relaxed);
+    stats->voiceFrames = atomic_load_explicit(&profile->voiceFrames, memory_order_relaxed);
+    stats->missed = atomic_load_explicit(&profile->missed, memory_order_relaxed);
+    stats->total = atomic_load_explicit(&profile->total, memory_order_relaxed);
+    stats->maxTotal = atomic_load_explicit(&profile->maxTotal, memory_order_relaxed);
+    for (int s = 0; s < SYNTH_STAGES_NUM; s++) {
+        stats->ticks[s] = atomic_load_explicit(&profile->ticks[s], memory_order_relaxed);
+        stats->maxTicks[s] = atomic_load_explicit(&profile->maxTicks[s], memory_order_relaxed);
+    }
+    stats->originTicks = profile->originTicks;
+#if defined(__x86_64__) || defined(__i386__)
+    const double elapsed = synth_profileGetClock() - profile->originClock;
+    stats->ticksPerSecond = elapsed > 0.0 ? (double) (synth_profileTicks() - profile->originTicks) / elapsed : 1e+9;
+#else
+    stats->ticksPerSecond = 1e+9;
+#endif
+}
+
+int synth_profileDrain(struct synth_Profile *profile, struct synth_ProfileBlock *blocks, const int max)
+{
+    assert(profile != NULL);
+    assert(blocks != NULL);
+    const size_t tail = atomic_load_explicit(&profile->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&profile->head, memory_order_acquire);
+    int num = 0;
+    while (num < max && tail + num != head) {
+        blocks[num] = profile->records[(tail + num) & PROFILE_MASK];
+        num++;
+    }
+    atomic_store_explicit(&profile->tail, tail + num, memory_order_release);
+    return num;
+}
@@ -0,0 +1,87 @@
+#ifndef SYNTH_PROFILE_H_
+#define SYNTH_PROFILE_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "synth.h"
+
+// -------------------------- +Const --------------------------
+
+// 1 compiles the counters in, without it every marker is an empty statement
+#ifndef SYNTH_PROFILE
+#define       SYNTH_PROFILE         0
+#endif
+
+#define       PROFILE_BLOCKS_NUM    1024
+
+// -------------------------- +Profile --------------------------
+
+/*
+ * Stage counters of the render thread. Markers add the ticks since the
+ * previous marker to a stage of the block in flight, at the end of a block
+ * its stages are folded into the totals and pushed into a single-producer /
+ * single-consumer ring for traces. The render thread is the only writer of
+ * the totals, readers see every field on its own, possibly a block apart.
+ *
+ * Ticks come from the time stamp counter where there is one and are
+ * calibrated against the monotonic clock when read, nanoseconds otherwise.
+ */
+struct synth_Profile
+{
+    struct synth_ProfileBlock block;
+    struct synth_ProfileStats totals;
+    atomic_ulong blocks;
+    atomic_ulong frames;
+    atomic_ulong voiceFrames;
+    _Atomic uint64_t total;
+    _Atomic uint64_t maxTotal;
+    _Atomic uint64_t ticks[SYNTH_STAGES_NUM];
+    _Atomic uint64_t maxTicks[SYNTH_STAGES_NUM];
+    uint64_t originTicks;
+    double originClock;
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+    struct synth_ProfileBlock records[PROFILE_BLOCKS_NUM];
+    atomic_ulong missed;
+};
+
+static inline uint64_t synth_profileTicks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+#endif
+}
+
+void synth_profileInit(struct synth_Profile *profile);
+
+// Render thread only
+void synth_profileBeginBlock(struct synth_Profile *profile);
+void synth_profileEndBlock(struct synth_Profile *profile, int frames);
+
+void synth_profileGet(struct synth_Profile *profile, struct synth_ProfileStats *stats);
+int synth_profileDrain(struct synth_Profile *profile, struct synth_ProfileBlock *blocks, int max);
+
+#if SYNTH_PROFILE
+// Starts a lap
+#define PROFILE_MARK(mark) uint64_t mark = synth_profileTicks()
+// Adds the lap to a stage of the block and starts the next one, the block may be NULL
+#define PROFILE_LAP(block, stage, mark) { const uint64_t lap = synth_profileTicks(); if ((block) != NULL) (block)->ticks[stage] += lap - (mark); (mark) = lap; }
+#define PROFILE_VOICES(block, frames) { if ((block) != NULL) (block)->voiceFrames += (frames); }
+#else
+#define PROFILE_MARK(mark)
+#define PROFILE_LAP(block, stage, mark)
+#define PROFILE_VOICES(block, frames)
+#endif
+
+#endif /* SYNTH_PROFILE_H_ */
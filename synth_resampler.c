@@ -0,0 +1,254 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "c11threads.h"
+
+#include "synth_resampler.h"
+
+// -------------------------- +Const --------------------------
+
+#define       PI                    ((float) M_PI)
+
+#define       RESAMPLER_ALIGN       64
+
+struct synth_ResamplerPreset
+{
+    int taps;
+    int phases;
+    float beta;     // Kaiser window shape, higher is deeper stopband and wider transition
+    float rolloff;  // cutoff relative to the Nyquist frequency of the lower rate
+};
+
+const struct synth_ResamplerPreset g_resamplerPresets[] =
+{
+    [SYNTH_RESAMPLER_FAST]   = { 8,  64,  5.0f, 0.80f },
+    [SYNTH_RESAMPLER_MEDIUM] = { 16, 128, 7.0f, 0.88f },
+    [SYNTH_RESAMPLER_BEST]   = { 32, 256, 9.0f, 0.93f }
+};
+
+#define       RESAMPLER_PRESETS_NUM 3
+#define       RESAMPLER_WINDOW_MAX  ((256 + 1) * 32)
+
+// -------------------------- +Kernel --------------------------
+
+// Zeroth order modified Bessel function of the first kind, the series converges fast
+float synth_resamplerBessel(const float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 32; k++) {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+        if (term < sum * 1e-9f) {
+            break;
+        }
+    }
+    return sum;
+}
+
+float synth_resamplerSinc(const float x)
+{
+    return x == 0.0f ? 1.0f : sinf(PI * x) / (PI * x);
+}
+
+/*
+ * The Kaiser window does not depend on the rates, it is tabulated once per
+ * process and preset, in the layout of the kernel. Most of the design cost
+ * is in the Bessel function, so further resamplers only evaluate the sinc.
+ */
+float g_resamplerWindows[RESAMPLER_PRESETS_NUM][RESAMPLER_WINDOW_MAX];
+once_flag g_resamplerWindowsOnce[RESAMPLER_PRESETS_NUM] = { ONCE_FLAG_INIT, ONCE_FLAG_INIT, ONCE_FLAG_INIT };
+
+void synth_resamplerTabulateWindow(const enum synth_ResamplerQuality quality)
+{
+    const struct synth_ResamplerPreset *preset = &g_resamplerPresets[quality];
+    const float half = preset->taps / 2.0f;
+    const float norm = synth_resamplerBessel(preset->beta);
+    for (int p = 0; p <= preset->phases; p++) {
+        float *row = g_resamplerWindows[quality] + (size_t) p * preset->taps;
+        const float fraction = (float) p / (float) preset->phases;
+        for (int j = 0; j < preset->taps; j++) {
+            const float ratio = (half - 1.0f + fraction - j) / half;
+            row[j] = ratio * ratio < 1.0f ? synth_resamplerBessel(preset->beta * sqrtf(1.0f - ratio * ratio)) / norm : 0.0f;
+        }
+    }
+}
+
+void synth_resamplerTabulateFast(void) { synth_resamplerTabulateWindow(SYNTH_RESAMPLER_FAST); }
+void synth_resamplerTabulateMedium(void) { synth_resamplerTabulateWindow(SYNTH_RESAMPLER_MEDIUM); }
+void synth_resamplerTabulateBest(void) { synth_resamplerTabulateWindow(SYNTH_RESAMPLER_BEST); }
+
+void (*const g_resamplerTabulators[RESAMPLER_PRESETS_NUM])(void) =
+{
+    [SYNTH_RESAMPLER_FAST]   = synth_resamplerTabulateFast,
+    [SYNTH_RESAMPLER_MEDIUM] = synth_resamplerTabulateMedium,
+    [SYNTH_RESAMPLER_BEST]   = synth_resamplerTabulateBest
+};
+
+/*
+ * Row p holds the taps for an output p / phases of a frame past the middle
+ * of the window. Every row is scaled to unity gain at DC.
+ */
+void synth_resamplerDesign(struct synth_Resampler *resampler, const enum synth_ResamplerQuality quality)
+{
+    const struct synth_ResamplerPreset *preset = &g_resamplerPresets[quality];
+    call_once(&g_resamplerWindowsOnce[quality], g_resamplerTabulators[quality]);
+    const int taps = resampler->taps;
+    const float half = taps / 2.0f;
+    const int lower = resampler->inRate < resampler->outRate ? resampler->inRate : resampler->outRate;
+    const float cutoff = preset->rolloff * (float) lower / (float) resampler->inRate;
+    for (int p = 0; p <= resampler->phases; p++) {
+        float *row = resampler->kernel + (size_t) p * taps;
+        const float *window = g_resamplerWindows[quality] + (size_t) p * taps;
+        const float fraction = (float) p / (float) resampler->phases;
+        float sum = 0.0f;
+        for (int j = 0; j < taps; j++) {
+            const float distance = half - 1.0f + fraction - j;
+            row[j] = cutoff * synth_resamplerSinc(cutoff * distance) * window[j];
+            sum += row[j];
+        }
+        for (int j = 0; j < taps; j++) {
+            row[j] /= sum;
+        }
+    }
+}
+
+// -------------------------- +Resampler --------------------------
+
+int synth_resamplerGcd(int a, int b)
+{
+    while (b != 0) {
+        const int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+size_t synth_resamplerAligned(const size_t floats)
+{
+    return ((floats * sizeof(float) + RESAMPLER_ALIGN - 1) / RESAMPLER_ALIGN) * RESAMPLER_ALIGN;
+}
+
+bool synth_resamplerCreate(struct synth_Resampler *resampler, const int inRate, const int outRate, const enum synth_ResamplerQuality quality, const int maxFrames)
+{
+    assert(resampler != NULL);
+    assert(inRate > 0 && outRate > 0);
+    assert(quality >= SYNTH_RESAMPLER_FAST && quality <= SYNTH_RESAMPLER_BEST);
+    memset(resampler, 0, sizeof(struct synth_Resampler));
+    const struct synth_ResamplerPreset *preset = &g_resamplerPresets[quality];
+    const int gcd = synth_resamplerGcd(inRate, outRate);
+    resampler->inRate = inRate / gcd;
+    resampler->outRate = outRate / gcd;
+    resampler->taps = preset->taps;
+    resampler->phases = preset->phases;
+    resampler->capacity = maxFrames + resampler->taps;
+    const size_t kernelSize = synth_resamplerAligned((size_t) (resampler->phases + 1) * resampler->taps);
+    const size_t coeffsSize = synth_resamplerAligned(resampler->taps);
+    const size_t inputSize = synth_resamplerAligned(resampler->capacity);
+    resampler->memory = aligned_alloc(RESAMPLER_ALIGN, kernelSize + coeffsSize + inputSize * SYNTH_OUTPUT_CHANNELS);
+    if (resampler->memory == NULL) {
+        return false;
+    }
+    char *memory = resampler->memory;
+    resampler->kernel = (float *) memory; memory += kernelSize;
+    resampler->coeffs = (float *) memory; memory += coeffsSize;
+    for (int c = 0; c < SYNTH_OUTPUT_CHANNELS; c++) {
+        resampler->input[c] = (float *) memory; memory += inputSize;
+        memset(resampler->input[c], 0, inputSize);
+    }
+    synth_resamplerDesign(resampler, quality);
+    synth_resamplerReset(resampler);
+    return true;
+}
+
+void synth_resamplerDestroy(struct synth_Resampler *resampler)
+{
+    assert(resampler != NULL);
+    free(resampler->memory);
+    memset(resampler, 0, sizeof(struct synth_Resampler));
+}
+
+// Silence before the first frame fills the first half of the window
+void synth_resamplerReset(struct synth_Resampler *resampler)
+{
+    resampler->length = resampler->taps / 2 - 1;
+    resampler->position = 0;
+    resampler->fraction = 0;
+    for (int c = 0; c < SYNTH_OUTPUT_CHANNELS; c++) {
+        memset(resampler->input[c], 0, resampler->length * sizeof(float));
+    }
+}
+
+bool synth_resamplerPush(struct synth_Resampler *resampler, const float *input, const int frames)
+{
+    assert(resampler != NULL);
+    if (resampler->length + frames > resampler->capacity) {
+        return false;
+    }
+    for (int c = 0; c < SYNTH_OUTPUT_CHANNELS; c++) {
+        float *target = resampler->input[c] + resampler->length;
+        for (int i = 0; i < frames; i++) {
+            target[i] = input[i * SYNTH_OUTPUT_CHANNELS + c];
+        }
+    }
+    resampler->length += frames;
+    return true;
+}
+
+void synth_resamplerInterpolate(struct synth_Resampler *resampler)
+{
+    const float phase = (float) resampler->fraction * resampler->phases / (float) resampler->outRate;
+    const int row = (int) phase;
+    const float weight = phase - row;
+    const float *restrict from = resampler->kernel + (size_t) row * resampler->taps;
+    const float *restrict to = from + resampler->taps;
+    float *restrict coeffs = resampler->coeffs;
+    for (int j = 0; j < resampler->taps; j++) {
+        coeffs[j] = from[j] + weight * (to[j] - from[j]);
+    }
+}
+
+// Every lane keeps its own partial sum, so the loop over taps vectorizes
+float synth_resamplerConvolve(const float *restrict coeffs, const float *restrict input, const int taps)
+{
+    float lanes[RESAMPLER_LANES] = { 0.0f };
+    for (int j = 0; j < taps; j += RESAMPLER_LANES) {
+        for (int l = 0; l < RESAMPLER_LANES; l++) {
+            lanes[l] += coeffs[j + l] * input[j + l];
+        }
+    }
+    float sum = 0.0f;
+    for (int l = 0; l < RESAMPLER_LANES; l++) {
+        sum += lanes[l];
+    }
+    return sum;
+}
+
+int synth_resamplerPull(struct synth_Resampler *resampler, float *output, const int frames)
+{
+    assert(resampler != NULL);
+    int produced = 0;
+    while (produced < frames && resampler->position + resampler->taps <= resampler->length) {
+        synth_resamplerInterpolate(resampler);
+        for (int c = 0; c < SYNTH_OUTPUT_CHANNELS; c++) {
+            const float *input = resampler->input[c] + resampler->position;
+            output[produced * SYNTH_OUTPUT_CHANNELS + c] = synth_resamplerConvolve(resampler->coeffs, input, resampler->taps);
+        }
+        produced++;
+        resampler->fraction += resampler->inRate;
+        resampler->position += resampler->fraction / resampler->outRate;
+        resampler->fraction %= resampler->outRate;
+    }
+    const int consumed = resampler->position < resampler->length ? resampler->position : resampler->length;
+    if (consumed > 0) {
+        for (int c = 0; c < SYNTH_OUTPUT_CHANNELS; c++) {
+            memmove(resampler->input[c], resampler->input[c] + consumed, (resampler->length - consumed) * sizeof(float));
+        }
+        resampler->length -= consumed;
+        resampler->position -= consumed;
+    }
+    return produced;
+}
@@ -0,0 +1,55 @@
+#ifndef SYNTH_RESAMPLER_H_
+#define SYNTH_RESAMPLER_H_
+
+#include <stdbool.h>
+
+#include "synth.h"
+
+// -------------------------- +Const --------------------------
+
+// Taps are processed in groups of RESAMPLER_LANES
+#define       RESAMPLER_LANES       8
+
+// -------------------------- +Resampler --------------------------
+
+/*
+ * Streaming polyphase resampler for interleaved SYNTH_OUTPUT_CHANNELS
+ * frames. The kernel is a Kaiser windowed sinc tabulated at a fixed number
+ * of phases, coefficients between two phases are interpolated linearly, so
+ * any pair of rates works with the same table. The cutoff follows the lower
+ * of the two rates.
+ *
+ * The position is exact: an integer frame plus a fraction counted in
+ * 1 / outRate units, so long renders never drift.
+ *
+ * Input is kept in planar form, the history the kernel needs followed by
+ * the pushed frames, and is compacted after every pull.
+ */
+struct synth_Resampler
+{
+    int inRate;
+    int outRate;
+    int taps;
+    int phases;
+    float *kernel;      // phases + 1 rows of taps coefficients
+    float *coeffs;      // coefficients of the current fraction
+    float *input[SYNTH_OUTPUT_CHANNELS];
+    int capacity;
+    int length;
+    int position;
+    int fraction;
+    void *memory;
+};
+
+// Pushes of up to maxFrames fit once a pull has drained the input
+bool synth_resamplerCreate(struct synth_Resampler *resampler, int inRate, int outRate, enum synth_ResamplerQuality quality, int maxFrames);
+void synth_resamplerDestroy(struct synth_Resampler *resampler);
+
+void synth_resamplerReset(struct synth_Resampler *resampler);
+
+// Appends input frames, returns false when they do not fit
+bool synth_resamplerPush(struct synth_Resampler *resampler, const float *input, int frames);
+// Produces up to frames output frames, fewer when the input runs out
+int synth_resamplerPull(struct synth_Resampler *resampler, float *output, int frames);
+
+#endif /* SYNTH_RESAMPLER_H_ */
@@ -0,0 +1,95 @@
+#define _GNU_SOURCE
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "synth_rt.h"
+#include "synth_log.h"
+
+// -------------------------- +Realtime --------------------------
+
+void synth_rtConfigDefault(struct synth_RtConfig *config)
+{
+    assert(config != NULL);
+    config->enabled = false;
+    config->cpu = -1;
+    config->priority = 80;
+}
+
+/*
+ * Only the mappings that exist now are locked, never future ones: sample
+ * libraries are mapped later and stream through the page cache, locking
+ * them would keep every page they ever touched. Where the kernel supports
+ * it pages lock as they fault in, so untouched reservations stay free.
+ * Engine memory is written when it is created, so it is resident already.
+ */
+bool synth_rtLockMemory()
+{
+#ifdef MCL_ONFAULT
+    if (mlockall(MCL_CURRENT | MCL_ONFAULT) == 0) {
+        logi("Current memory is locked on fault");
+        return true;
+    }
+#endif
+    if (mlockall(MCL_CURRENT) != 0) {
+        logw("mlockall() failed: %s, memory stays pageable", strerror(errno));
+        return false;
+    }
+    logi("All current pages are locked");
+    return true;
+}
+
+bool synth_rtSetPriority(const int priority)
+{
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    const int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (result != 0) {
+        logw("SCHED_FIFO %d is not permitted: %s, keeping the default policy", priority, strerror(result));
+        return false;
+    }
+    logi("Thread runs with SCHED_FIFO %d", priority);
+    return true;
+}
+
+bool synth_rtPinToCpu(const int cpu)
+{
+    if (cpu < 0) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    const int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (result != 0) {
+        logw("Cannot pin the thread to CPU %d: %s", cpu, strerror(result));
+        return false;
+    }
+    logi("Thread is pinned to CPU %d", cpu);
+    return true;
+}
+
+void synth_rtPrefaultStack()
+{
+    volatile char stack[SYNTH_RT_STACK_PREFAULT];
+    for (int i = 0; i < SYNTH_RT_STACK_PREFAULT; i += 4096) {
+        stack[i] = 0;
+    }
+    (void) stack[0];
+}
+
+void synth_rtEnterThread(const struct synth_RtConfig *config)
+{
+    assert(config != NULL);
+    if (!config->enabled) {
+        return;
+    }
+    synth_rtSetPriority(config->priority);
+    synth_rtPinToCpu(config->cpu);
+    synth_rtPrefaultStack();
+}
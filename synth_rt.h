@@ -0,0 +1,37 @@
+#ifndef SYNTH_RT_H_
+#define SYNTH_RT_H_
+
+#include <stdbool.h>
+
+// -------------------------- +Realtime --------------------------
+
+/*
+ * Helpers for running a render thread in real time. Each of them reports
+ * the failure and returns false, so callers can carry on with defaults
+ * when the process lacks the privileges.
+ */
+
+#define       SYNTH_RT_STACK_PREFAULT   (64 * 1024)
+
+struct synth_RtConfig
+{
+    bool enabled;
+    int cpu;
+    int priority;
+};
+
+void synth_rtConfigDefault(struct synth_RtConfig *config);
+
+// Locks the pages mapped now, call after creating the engine and before
+// mapping samples, which stay pageable
+bool synth_rtLockMemory();
+
+// Applied to the calling thread
+bool synth_rtSetPriority(int priority);
+bool synth_rtPinToCpu(int cpu);
+void synth_rtPrefaultStack();
+
+// All of the above for the calling thread, according to the config
+void synth_rtEnterThread(const struct synth_RtConfig *config);
+
+#endif /* SYNTH_RT_H_ */
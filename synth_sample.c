@@ -0,0 +1,338 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "synth_sample.h"
+#include "synth_log.h"
+
+// -------------------------- +Const --------------------------
+
+#define       SAMPLE_REQUESTS_MASK  (SAMPLE_REQUESTS_NUM - 1)
+
+#define       SAMPLE_PREFETCH_PERIOD 2000000L
+
+#define       WAV_FORMAT_PCM        0x0001
+#define       WAV_FORMAT_FLOAT      0x0003
+#define       WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+// -------------------------- +Wav --------------------------
+
+uint32_t synth_wavRead32(const unsigned char *bytes)
+{
+    return (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 | (uint32_t) bytes[2] << 16 | (uint32_t) bytes[3] << 24;
+}
+
+uint16_t synth_wavRead16(const unsigned char *bytes)
+{
+    return (uint16_t) (bytes[0] | bytes[1] << 8);
+}
+
+bool synth_wavParseFormat(struct synth_Sample *sample, const unsigned char *chunk, const uint32_t size)
+{
+    if (size < 16) {
+        return false;
+    }
+    uint16_t format = synth_wavRead16(chunk);
+    const int bits = synth_wavRead16(chunk + 14);
+    if (format == WAV_FORMAT_EXTENSIBLE && size >= 26) {
+        format = synth_wavRead16(chunk + 24);
+    }
+    sample->channels = synth_wavRead16(chunk + 2);
+    sample->rate = (float) synth_wavRead32(chunk + 4);
+    sample->frameSize = synth_wavRead16(chunk + 12);
+    if (format == WAV_FORMAT_PCM && bits == 16) {
+        sample->format = SAMPLE_FORMAT_PCM16;
+    } else if (format == WAV_FORMAT_PCM && bits == 24) {
+        sample->format = SAMPLE_FORMAT_PCM24;
+    } else if (format == WAV_FORMAT_FLOAT && bits == 32) {
+        sample->format = SAMPLE_FORMAT_FLOAT32;
+    } else {
+        return false;
+    }
+    return sample->channels > 0 && sample->rate > 0.0f && sample->frameSize >= sample->channels * bits / 8;
+}
+
+// Unity note and the first loop, the loop end is inclusive in the file
+void synth_wavParseSampler(struct synth_Sample *sample, const unsigned char *chunk, const uint32_t size)
+{
+    if (size < 36) {
+        return;
+    }
+    const int unity = (int) synth_wavRead32(chunk + 12);
+    sample->rootFreq = 440.0f * powf(2.0f, (unity - 69) / 12.0f);
+    const uint32_t loops = synth_wavRead32(chunk + 28);
+    if (loops == 0 || size < 36 + 24) {
+        return;
+    }
+    sample->looping = true;
+    sample->loopStart = (int) synth_wavRead32(chunk + 36 + 8);
+    sample->loopEnd = (int) synth_wavRead32(chunk + 36 + 12) + 1;
+}
+
+bool synth_wavParse(struct synth_Sample *sample, const unsigned char *bytes, const size_t size)
+{
+    if (size < 12 || memcmp(bytes, "RIFF", 4) != 0 || memcmp(bytes + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+    bool hasFormat = false;
+    size_t dataSize = 0;
+    size_t offset = 12;
+    while (offset + 8 <= size) {
+        const unsigned char *chunk = bytes + offset + 8;
+        uint32_t chunkSize = synth_wavRead32(bytes + offset + 4);
+        if (chunkSize > size - offset - 8) {
+            chunkSize = (uint32_t) (size - offset - 8);
+        }
+        if (memcmp(bytes + offset, "fmt ", 4) == 0) {
+            hasFormat = synth_wavParseFormat(sample, chunk, chunkSize);
+        } else if (memcmp(bytes + offset, "data", 4) == 0) {
+            sample->data = chunk;
+            dataSize = chunkSize;
+        } else if (memcmp(bytes + offset, "smpl", 4) == 0) {
+            synth_wavParseSampler(sample, chunk, chunkSize);
+        }
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+    if (!hasFormat || sample->data == NULL) {
+        return false;
+    }
+    sample->frames = (int) (dataSize / sample->frameSize);
+    if (sample->looping && (sample->loopStart < 0 || sample->loopEnd > sample->frames || sample->loopStart >= sample->loopEnd)) {
+        sample->looping = false;
+    }
+    return sample->frames > 0;
+}
+
+// -------------------------- +Sample --------------------------
+
+// Mixes the channels of a frame from the mapping, may fault when the page is not resident
+float synth_sampleRead(const struct synth_Sample *sample, const int frame)
+{
+    const unsigned char *bytes = sample->data + (size_t) frame * sample->frameSize;
+    float sum = 0.0f;
+    for (int c = 0; c < sample->channels; c++) {
+        switch (sample->format) {
+            case SAMPLE_FORMAT_PCM16:
+            {
+                sum += (int16_t) synth_wavRead16(bytes) / 32768.0f;
+                bytes += 2;
+                break;
+            }
+            case SAMPLE_FORMAT_PCM24:
+            {
+                const int32_t value = (int32_t) ((uint32_t) bytes[0] << 8 | (uint32_t) bytes[1] << 16 | (uint32_t) bytes[2] << 24) >> 8;
+                sum += value / 8388608.0f;
+                bytes += 3;
+                break;
+            }
+            case SAMPLE_FORMAT_FLOAT32:
+            {
+                float value;
+                memcpy(&value, bytes, sizeof(value));
+                sum += value;
+                bytes += 4;
+                break;
+            }
+        }
+    }
+    return sum / (float) sample->channels;
+}
+
+bool synth_sampleLoad(struct synth_Sample *sample, const char *path)
+{
+    assert(sample != NULL);
+    assert(path != NULL);
+    memset(sample, 0, sizeof(struct synth_Sample));
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        logw("Cannot open the sample %s: %s", path, strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        logw("Cannot read the sample %s", path);
+        close(fd);
+        return false;
+    }
+    sample->mapSize = (size_t) info.st_size;
+    sample->map = mmap(NULL, sample->mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (sample->map == MAP_FAILED) {
+        logw("Cannot map the sample %s: %s", path, strerror(errno));
+        sample->map = NULL;
+        return false;
+    }
+    sample->rootFreq = 256.0f;
+    if (!synth_wavParse(sample, sample->map, sample->mapSize)) {
+        logw("Unsupported sample %s, expected 16 or 24 bit PCM or 32 bit float WAV", path);
+        synth_sampleUnload(sample);
+        return false;
+    }
+    sample->attackFrames = sample->frames < SAMPLE_ATTACK_FRAMES ? sample->frames : SAMPLE_ATTACK_FRAMES;
+    sample->attack = malloc(sample->attackFrames * sizeof(float));
+    if (sample->attack == NULL) {
+        synth_sampleUnload(sample);
+        return false;
+    }
+    for (int i = 0; i < sample->attackFrames; i++) {
+        sample->attack[i] = synth_sampleRead(sample, i);
+    }
+    logi("Sample %s: %d frames at %.0f Hz, %d channels%s", path, sample->frames, sample->rate, sample->channels, sample->looping ? ", looped" : "");
+    return true;
+}
+
+void synth_sampleUnload(struct synth_Sample *sample)
+{
+    assert(sample != NULL);
+    if (sample->map != NULL) {
+        munmap(sample->map, sample->mapSize);
+    }
+    free(sample->attack);
+    memset(sample, 0, sizeof(struct synth_Sample));
+}
+
+float synth_sampleFrame(const struct synth_Sample *sample, int frame)
+{
+    if (sample->looping && frame >= sample->loopEnd) {
+        frame = sample->loopStart + (frame - sample->loopEnd) % (sample->loopEnd - sample->loopStart);
+    }
+    if (frame < 0 || frame >= sample->frames) {
+        return 0.0f;
+    }
+    if (frame < sample->attackFrames) {
+        return sample->attack[frame];
+    }
+    return synth_sampleRead(sample, frame);
+}
+
+// Brings the pages of the frames in, one read per page
+void synth_sampleTouch(const struct synth_Sample *sample, const int from, const int to)
+{
+    if (from >= to) {
+        return;
+    }
+    const size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    const unsigned char *start = sample->data + (size_t) from * sample->frameSize;
+    const unsigned char *end = sample->data + (size_t) to * sample->frameSize;
+    const unsigned char *aligned = (const unsigned char *) ((uintptr_t) start & ~(uintptr_t) (page - 1));
+    madvise((void *) aligned, end - aligned, MADV_WILLNEED);
+    volatile unsigned char sink = 0;
+    for (const unsigned char *byte = aligned; byte < end; byte += page) {
+        sink += *byte;
+    }
+    (void) sink;
+}
+
+// -------------------------- +Bank --------------------------
+
+bool synth_sampleBankRequestPop(struct synth_SampleBank *bank, struct synth_SampleRequest *request)
+{
+    const size_t head = atomic_load_explicit(&bank->head, memory_order_relaxed);
+    const size_t tail = atomic_load_explicit(&bank->tail, memory_order_acquire);
+    if (head == tail) {
+        return false;
+    }
+    *request = bank->requests[head & SAMPLE_REQUESTS_MASK];
+    atomic_store_explicit(&bank->head, head + 1, memory_order_release);
+    return true;
+}
+
+// A looped voice reads the loop start next, it is brought in before the wrap
+void synth_sampleBankPrefetch(struct synth_SampleBank *bank, const struct synth_SampleRequest *request)
+{
+    const struct synth_Sample *sample = &bank->samples[request->sample];
+    int to = request->frame + SAMPLE_PREFETCH_FRAMES;
+    if (sample->looping && to > sample->loopEnd) {
+        const int wrapped = sample->loopStart + to - sample->loopEnd;
+        synth_sampleTouch(sample, sample->loopStart, wrapped < sample->loopEnd ? wrapped : sample->loopEnd);
+        to = sample->loopEnd;
+    }
+    synth_sampleTouch(sample, request->frame, to < sample->frames ? to : sample->frames);
+}
+
+int synth_sampleBankThread(void *arg)
+{
+    struct synth_SampleBank *bank = arg;
+    const struct timespec period = { .tv_sec = 0, .tv_nsec = SAMPLE_PREFETCH_PERIOD };
+    while (!atomic_load(&bank->stopping)) {
+        struct synth_SampleRequest request;
+        while (synth_sampleBankRequestPop(bank, &request)) {
+            synth_sampleBankPrefetch(bank, &request);
+        }
+        const unsigned long missed = atomic_exchange_explicit(&bank->missed, 0, memory_order_relaxed);
+        if (missed > 0) {
+            logw("%lu sample prefetch requests dropped", missed);
+        }
+        thrd_sleep(&period, NULL);
+    }
+    return 0;
+}
+
+bool synth_sampleBankInit(struct synth_SampleBank *bank)
+{
+    assert(bank != NULL);
+    memset(bank, 0, sizeof(struct synth_SampleBank));
+    return mtx_init(&bank->lock, mtx_plain) == thrd_success;
+}
+
+void synth_sampleBankDestroy(struct synth_SampleBank *bank)
+{
+    assert(bank != NULL);
+    if (atomic_exchange(&bank->running, false)) {
+        atomic_store(&bank->stopping, true);
+        thrd_join(bank->thread, NULL);
+    }
+    for (int i = 0; i < bank->num; i++) {
+        synth_sampleUnload(&bank->samples[i]);
+    }
+    mtx_destroy(&bank->lock);
+}
+
+int synth_sampleBankLoad(struct synth_SampleBank *bank, const char *path)
+{
+    assert(bank != NULL);
+    mtx_lock(&bank->lock);
+    const int index = bank->num;
+    if (index >= SYNTH_SAMPLES_NUM || !synth_sampleLoad(&bank->samples[index], path)) {
+        mtx_unlock(&bank->lock);
+        return -1;
+    }
+    bank->num++;
+    atomic_store_explicit(&bank->loaded[index], true, memory_order_release);
+    if (!atomic_load(&bank->running)) {
+        if (thrd_create(&bank->thread, synth_sampleBankThread, bank) == thrd_success) {
+            atomic_store(&bank->running, true);
+        } else {
+            logw("Cannot start the sample prefetch thread, the render thread reads the mapping directly");
+        }
+    }
+    mtx_unlock(&bank->lock);
+    return index;
+}
+
+const struct synth_Sample *synth_sampleBankGet(struct synth_SampleBank *bank, const int index)
+{
+    if (index < 0 || index >= SYNTH_SAMPLES_NUM || !atomic_load_explicit(&bank->loaded[index], memory_order_acquire)) {
+        return NULL;
+    }
+    return &bank->samples[index];
+}
+
+void synth_sampleBankRequest(struct synth_SampleBank *bank, const int index, const int frame)
+{
+    const size_t tail = atomic_load_explicit(&bank->tail, memory_order_relaxed);
+    const size_t head = atomic_load_explicit(&bank->head, memory_order_acquire);
+    if (tail - head >= SAMPLE_REQUESTS_NUM) {
+        atomic_fetch_add_explicit(&bank->missed, 1, memory_order_relaxed);
+        return;
+    }
+    bank->requests[tail & SAMPLE_REQUESTS_MASK] = (struct synth_SampleRequest) { index, frame };
+    atomic_store_explicit(&bank->tail, tail + 1, memory_order_release);
+}
@@ -0,0 +1,107 @@
+#ifndef SYNTH_SAMPLE_H_
+#define SYNTH_SAMPLE_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "c11threads.h"
+
+#include "synth.h"
+
+// -------------------------- +Const --------------------------
+
+// Frames converted up front, notes start without touching the mapping
+#define       SAMPLE_ATTACK_FRAMES  16384
+
+// Frames kept resident ahead of every playing voice
+#define       SAMPLE_PREFETCH_FRAMES 65536
+
+#define       SAMPLE_REQUESTS_NUM   256
+
+// -------------------------- +Sample --------------------------
+
+enum synth_SampleFormat
+{
+    SAMPLE_FORMAT_PCM16,
+    SAMPLE_FORMAT_PCM24,
+    SAMPLE_FORMAT_FLOAT32
+};
+
+/*
+ * WAV file mapped into memory. The attack is converted to mono floats when
+ * the file loads, the rest is read straight from the mapping and only
+ * pages the prefetch thread touched are resident. Channels are mixed down
+ * to mono, parts pan afterwards.
+ *
+ * Loop points and the root note come from the smpl chunk when the file has
+ * one, otherwise the sample plays once at its own pitch for note 0.
+ */
+struct synth_Sample
+{
+    void *map;
+    size_t mapSize;
+    const unsigned char *data;
+    enum synth_SampleFormat format;
+    int channels;
+    int frameSize;
+    int frames;
+    float rate;
+    float rootFreq;
+    bool looping;
+    int loopStart;
+    int loopEnd;
+    float *attack;
+    int attackFrames;
+};
+
+bool synth_sampleLoad(struct synth_Sample *sample, const char *path);
+void synth_sampleUnload(struct synth_Sample *sample);
+
+// Mono value of a frame, looped past the loop end and silent outside the sample
+float synth_sampleFrame(const struct synth_Sample *sample, int frame);
+
+// -------------------------- +Bank --------------------------
+
+struct synth_SampleRequest
+{
+    int sample;
+    int frame;
+};
+
+/*
+ * Samples of one engine. Loading takes a lock and never runs on the render
+ * thread, a slot becomes visible to the render thread once it is complete.
+ *
+ * The render thread posts the play positions of its voices into a
+ * single-producer / single-consumer ring, the prefetch thread touches the
+ * pages ahead of them, so the render thread does not fault on the mapping.
+ * Requests that do not fit are dropped and counted.
+ */
+struct synth_SampleBank
+{
+    struct synth_Sample samples[SYNTH_SAMPLES_NUM];
+    atomic_bool loaded[SYNTH_SAMPLES_NUM];
+    mtx_t lock;
+    int num;
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+    struct synth_SampleRequest requests[SAMPLE_REQUESTS_NUM];
+    atomic_ulong missed;
+    thrd_t thread;
+    atomic_bool running;
+    atomic_bool stopping;
+};
+
+bool synth_sampleBankInit(struct synth_SampleBank *bank);
+void synth_sampleBankDestroy(struct synth_SampleBank *bank);
+
+// Index of the loaded sample or -1, starts the prefetch thread with the first sample
+int synth_sampleBankLoad(struct synth_SampleBank *bank, const char *path);
+// NULL until the slot is loaded
+const struct synth_Sample *synth_sampleBankGet(struct synth_SampleBank *bank, int index);
+
+// Render thread only, never blocks
+void synth_sampleBankRequest(struct synth_SampleBank *bank, int index, int frame);
+
+#endif /* SYNTH_SAMPLE_H_ */
@@ -0,0 +1,257 @@
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "synth_shm.h"
+#include "synth_log.h"
+
+// -------------------------- +Const --------------------------
+
+#define       SHM_ALIGN             4096
+
+// The watcher looks at the readers this often
+#define       SHM_WATCH_NSEC        100000000L
+
+// -------------------------- +Writer --------------------------
+
+size_t synth_shmDataOffset()
+{
+    return ((sizeof(struct synth_ShmHeader) + SHM_ALIGN - 1) / SHM_ALIGN) * SHM_ALIGN;
+}
+
+// Slots of readers that exited without detaching are freed
+void synth_shmRingCheckReaders(struct synth_ShmRing *ring)
+{
+    struct synth_ShmHeader *header = ring->header;
+    const uint64_t written = atomic_load_explicit(&header->writeFrame, memory_order_acquire);
+    for (int i = 0; i < SYNTH_SHM_READERS_MAX; i++) {
+        const uint32_t pid = atomic_load_explicit(&header->slots[i].pid, memory_order_relaxed);
+        if (pid == 0) {
+            ring->lapped[i] = false;
+            continue;
+        }
+        const uint64_t behind = written - atomic_load_explicit(&header->slots[i].readFrame, memory_order_relaxed);
+        if (behind <= header->frames) {
+            ring->lapped[i] = false;
+            continue;
+        }
+        if (ring->lapped[i]) {
+            continue;
+        }
+        ring->lapped[i] = true;
+        ring->overruns++;
+        if (kill((pid_t) pid, 0) != 0 && errno == ESRCH) {
+            logw("Output ring reader %u is gone, its slot is freed", pid);
+            atomic_compare_exchange_strong(&header->slots[i].pid, &(uint32_t) { pid }, 0);
+        } else {
+            logw("Output ring reader %u is %llu frames behind, its frames were overwritten", pid, (unsigned long long) behind);
+        }
+    }
+}
+
+// Keeps the system calls and the reports off the render thread
+int synth_shmRingWatch(void *arg)
+{
+    struct synth_ShmRing *ring = arg;
+    const struct timespec period = { .tv_sec = 0, .tv_nsec = SHM_WATCH_NSEC };
+    while (!atomic_load(&ring->stopping)) {
+        synth_shmRingCheckReaders(ring);
+        thrd_sleep(&period, NULL);
+    }
+    return 0;
+}
+
+bool synth_shmRingCreate(struct synth_ShmRing *ring, const char *name, const int sampleRate, const int channels, const int frames)
+{
+    assert(ring != NULL);
+    assert(name != NULL);
+    assert(sampleRate > 0 && channels > 0 && frames > 0);
+    memset(ring, 0, sizeof(struct synth_ShmRing));
+    if (strlen(name) >= sizeof(ring->name)) {
+        logw("Shared memory name is too long: %s", name);
+        return false;
+    }
+    uint32_t capacity = 1;
+    while (capacity < (uint32_t) frames) {
+        capacity <<= 1;
+    }
+    ring->size = synth_shmDataOffset() + (size_t) capacity * channels * sizeof(float);
+    const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        if (errno == EEXIST) {
+            logw("Shared memory %s exists, another engine may use it. Pick another name or remove a stale one", name);
+        } else {
+            logw("Cannot open the shared memory %s: %s", name, strerror(errno));
+        }
+        return false;
+    }
+    if (ftruncate(fd, (off_t) ring->size) != 0) {
+        logw("Cannot size the shared memory %s: %s", name, strerror(errno));
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+    void *map = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        logw("Cannot map the shared memory %s: %s", name, strerror(errno));
+        shm_unlink(name);
+        return false;
+    }
+    memset(map, 0, ring->size);
+    strcpy(ring->name, name);
+    ring->header = map;
+    ring->data = (float *) ((char *) map + synth_shmDataOffset());
+    ring->channels = channels;
+    struct synth_ShmHeader *header = ring->header;
+    header->version = SYNTH_SHM_VERSION;
+    header->sampleRate = (uint32_t) sampleRate;
+    header->channels = (uint32_t) channels;
+    header->frames = capacity;
+    header->dataOffset = (uint32_t) synth_shmDataOffset();
+    atomic_store_explicit(&header->magic, SYNTH_SHM_MAGIC, memory_order_release);
+    atomic_init(&ring->stopping, false);
+    if (thrd_create(&ring->watcher, synth_shmRingWatch, ring) != thrd_success) {
+        logw("Cannot start the output ring watcher");
+        munmap(ring->header, ring->size);
+        shm_unlink(name);
+        memset(ring, 0, sizeof(struct synth_ShmRing));
+        return false;
+    }
+    logi("Output ring %s: %u frames of %d channels at %d Hz", name, capacity, channels, sampleRate);
+    return true;
+}
+
+void synth_shmRingDestroy(struct synth_ShmRing *ring)
+{
+    assert(ring != NULL);
+    if (ring->header == NULL) {
+        return;
+    }
+    atomic_store(&ring->stopping, true);
+    thrd_join(ring->watcher, NULL);
+    atomic_store(&ring->header->magic, 0);
+    munmap(ring->header, ring->size);
+    shm_unlink(ring->name);
+    if (ring->overruns > 0) {
+        logi("Output ring readers were overrun %lu times", ring->overruns);
+    }
+    memset(ring, 0, sizeof(struct synth_ShmRing));
+}
+
+void synth_shmRingWrite(struct synth_ShmRing *ring, const float *input, const int frames)
+{
+    assert(ring != NULL);
+    struct synth_ShmHeader *header = ring->header;
+    const uint32_t mask = header->frames - 1;
+    atomic_store_explicit(&header->reserveFrame, ring->frame + frames, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    int done = 0;
+    while (done < frames) {
+        const uint32_t index = (uint32_t) ((ring->frame + done) & mask);
+        int chunk = (int) (header->frames - index);
+        chunk = chunk < frames - done ? chunk : frames - done;
+        memcpy(ring->data + (size_t) index * ring->channels, input + (size_t) done * ring->channels, (size_t) chunk * ring->channels * sizeof(float));
+        done += chunk;
+    }
+    ring->frame += frames;
+    atomic_store_explicit(&header->writeFrame, ring->frame, memory_order_release);
+}
+
+// -------------------------- +Reader --------------------------
+
+bool synth_shmReaderAttach(struct synth_ShmReader *reader, const char *name)
+{
+    assert(reader != NULL);
+    assert(name != NULL);
+    memset(reader, 0, sizeof(struct synth_ShmReader));
+    reader->slot = -1;
+    const int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        logw("Cannot open the shared memory %s: %s", name, strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(struct synth_ShmHeader)) {
+        close(fd);
+        return false;
+    }
+    reader->size = (size_t) info.st_size;
+    void *map = mmap(NULL, reader->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    reader->header = map;
+    struct synth_ShmHeader *header = reader->header;
+    if (atomic_load_explicit(&header->magic, memory_order_acquire) != SYNTH_SHM_MAGIC || header->version != SYNTH_SHM_VERSION
+            || header->dataOffset + (size_t) header->frames * header->channels * sizeof(float) > reader->size) {
+        logw("Shared memory %s is not an output ring", name);
+        synth_shmReaderDetach(reader);
+        return false;
+    }
+    reader->data = (const float *) ((const char *) map + header->dataOffset);
+    const uint32_t pid = (uint32_t) getpid();
+    for (int i = 0; i < SYNTH_SHM_READERS_MAX; i++) {
+        uint32_t expected = 0;
+        if (atomic_compare_exchange_strong(&header->slots[i].pid, &expected, pid)) {
+            reader->slot = i;
+            break;
+        }
+    }
+    if (reader->slot < 0) {
+        logw("Output ring %s has no free reader slot", name);
+        synth_shmReaderDetach(reader);
+        return false;
+    }
+    reader->frame = atomic_load_explicit(&header->writeFrame, memory_order_acquire);
+    atomic_store_explicit(&header->slots[reader->slot].readFrame, reader->frame, memory_order_relaxed);
+    return true;
+}
+
+void synth_shmReaderDetach(struct synth_ShmReader *reader)
+{
+    assert(reader != NULL);
+    if (reader->header == NULL) {
+        return;
+    }
+    if (reader->slot >= 0) {
+        atomic_store(&reader->header->slots[reader->slot].pid, 0);
+    }
+    munmap(reader->header, reader->size);
+    memset(reader, 0, sizeof(struct synth_ShmReader));
+}
+
+int synth_shmReaderAcquire(struct synth_ShmReader *reader, const float **samples, const int frames)
+{
+    assert(reader != NULL);
+    const struct synth_ShmHeader *header = reader->header;
+    const uint64_t written = atomic_load_explicit(&header->writeFrame, memory_order_acquire);
+    if (written - reader->frame > header->frames) {
+        const uint64_t oldest = written - header->frames / 2;
+        reader->lost += oldest - reader->frame;
+        reader->frame = oldest;
+    }
+    const uint32_t index = (uint32_t) (reader->frame & (header->frames - 1));
+    uint64_t available = written - reader->frame;
+    available = available < header->frames - index ? available : header->frames - index;
+    *samples = reader->data + (size_t) index * header->channels;
+    return (int) (available < (uint64_t) frames ? available : (uint64_t) frames);
+}
+
+bool synth_shmReaderRelease(struct synth_ShmReader *reader, const int frames)
+{
+    assert(reader != NULL);
+    struct synth_ShmHeader *header = reader->header;
+    atomic_thread_fence(memory_order_acquire);
+    const uint64_t reserved = atomic_load_explicit(&header->reserveFrame, memory_order_relaxed);
+    const bool valid = reserved - reader->frame <= header->frames;
+    reader->frame += frames;
+    atomic_store_explicit(&header->slots[reader->slot].readFrame, reader->frame, memory_order_relaxed);
+    return valid;
+}
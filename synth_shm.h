@@ -0,0 +1,103 @@
+#ifndef SYNTH_SHM_H_
+#define SYNTH_SHM_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "c11threads.h"
+
+// -------------------------- +Layout --------------------------
+
+/*
+ * Rendered audio in a POSIX shared memory object, for readers in other
+ * processes. The object starts with struct synth_ShmHeader, the samples
+ * follow at dataOffset: frames interleaved frames of channels 32 bit
+ * floats, frame n at index n & (frames - 1).
+ *
+ * The writer never waits. It stores reserveFrame before it copies a block
+ * and writeFrame after it, both count frames since the ring was created.
+ * A reader owns a slot and stores the frame it has read up to there. A
+ * thread of the writer process reports readers which fall more than a
+ * ring behind and frees the slots of readers that are gone.
+ *
+ * A reader may use frames [readFrame, writeFrame) in place. They stay
+ * valid while reserveFrame - readFrame <= frames, readers check that after
+ * using them, see synth_shmReaderRelease.
+ *
+ * Magic is written last, the ring is ready once it matches.
+ */
+
+#define       SYNTH_SHM_MAGIC       0x53594E4Fu  // "SYNO"
+#define       SYNTH_SHM_VERSION     1
+#define       SYNTH_SHM_READERS_MAX 8
+
+struct synth_ShmSlot
+{
+    _Alignas(64) _Atomic uint32_t pid;  // 0 when free
+    _Atomic uint64_t readFrame;
+};
+
+struct synth_ShmHeader
+{
+    _Atomic uint32_t magic;
+    uint32_t version;
+    uint32_t sampleRate;
+    uint32_t channels;
+    uint32_t frames;
+    uint32_t dataOffset;
+    _Alignas(64) _Atomic uint64_t reserveFrame;
+    _Atomic uint64_t writeFrame;
+    struct synth_ShmSlot slots[SYNTH_SHM_READERS_MAX];
+};
+
+// -------------------------- +Writer --------------------------
+
+struct synth_ShmRing
+{
+    struct synth_ShmHeader *header;
+    float *data;
+    size_t size;
+    char name[64];
+    int channels;
+    uint64_t frame;
+    thrd_t watcher;
+    atomic_bool stopping;
+    bool lapped[SYNTH_SHM_READERS_MAX];     // watcher only
+    unsigned long overruns;
+};
+
+// Frames is rounded up to a power of two, the name starts with a slash. Fails
+// when the name is taken, another engine may be writing there
+bool synth_shmRingCreate(struct synth_ShmRing *ring, const char *name, int sampleRate, int channels, int frames);
+void synth_shmRingDestroy(struct synth_ShmRing *ring);
+
+// Never blocks and never looks at the readers, a watcher thread reports
+// readers a ring behind once per overrun
+void synth_shmRingWrite(struct synth_ShmRing *ring, const float *input, int frames);
+
+// -------------------------- +Reader --------------------------
+
+struct synth_ShmReader
+{
+    struct synth_ShmHeader *header;
+    const float *data;
+    size_t size;
+    int slot;
+    uint64_t frame;
+    unsigned long lost;
+};
+
+// Claims a free slot, reading starts at the newest frame
+bool synth_shmReaderAttach(struct synth_ShmReader *reader, const char *name);
+void synth_shmReaderDetach(struct synth_ShmReader *reader);
+
+// Points at up to frames unread frames in place, fewer where the ring wraps.
+// A reader more than a ring behind skips to half a ring behind the writer
+// and counts the frames it lost
+int synth_shmReaderAcquire(struct synth_ShmReader *reader, const float **samples, int frames);
+// Marks frames as read, false when the writer overwrote them while they were used
+bool synth_shmReaderRelease(struct synth_ShmReader *reader, int frames);
+
+#endif /* SYNTH_SHM_H_ */
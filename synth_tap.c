@@ -0,0 +1,53 @@
+#include <assert.h>
+#include <string.h>
+
+#include "synth_tap.h"
+
+// -------------------------- +Const --------------------------
+
+#define       TAP_FRESH             4
+
+// -------------------------- +Tap --------------------------
+
+void synth_tapInit(struct synth_Tap *tap)
+{
+    assert(tap != NULL);
+    memset(tap->buffers, 0, sizeof(tap->buffers));
+    tap->back = 0;
+    tap->filled = 0;
+    tap->front = 2;
+    atomic_init(&tap->middle, 1);
+}
+
+void synth_tapWrite(struct synth_Tap *tap, const float *input, int frames)
+{
+    assert(tap != NULL);
+    while (frames > 0) {
+        int chunk = SYNTH_TAP_FRAMES - tap->filled;
+        if (chunk > frames) {
+            chunk = frames;
+        }
+        memcpy(tap->buffers[tap->back] + tap->filled * SYNTH_OUTPUT_CHANNELS,
+               input, chunk * SYNTH_OUTPUT_CHANNELS * sizeof(float));
+        tap->filled += chunk;
+        input += chunk * SYNTH_OUTPUT_CHANNELS;
+        frames -= chunk;
+        if (tap->filled == SYNTH_TAP_FRAMES) {
+            const int previous = atomic_exchange_explicit(&tap->middle, tap->back | TAP_FRESH,
+                                                          memory_order_acq_rel);
+            tap->back = previous & ~TAP_FRESH;
+            tap->filled = 0;
+        }
+    }
+}
+
+const float *synth_tapRead(struct synth_Tap *tap)
+{
+    assert(tap != NULL);
+    if ((atomic_load_explicit(&tap->middle, memory_order_relaxed) & TAP_FRESH) == 0) {
+        return NULL;
+    }
+    const int previous = atomic_exchange_explicit(&tap->middle, tap->front, memory_order_acq_rel);
+    tap->front = previous & ~TAP_FRESH;
+    return tap->buffers[tap->front];
+}
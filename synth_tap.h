@@ -0,0 +1,38 @@
+#ifndef SYNTH_TAP_H_
+#define SYNTH_TAP_H_
+
+#include <stdatomic.h>
+
+#include "synth.h"
+
+// -------------------------- +Const --------------------------
+
+// Interleaved frames per snapshot, also the spectrum size
+#define       SYNTH_TAP_FRAMES      2048
+
+// -------------------------- +Tap --------------------------
+
+/*
+ * Triple buffer between the audio thread and the view. The writer fills
+ * the back buffer and swaps it with the middle one once it is full, the
+ * reader swaps the middle one into the front when it is marked fresh.
+ * Neither side waits for the other: a slow reader sees the latest complete
+ * snapshot and skips the rest, a slow writer leaves the front as it is.
+ */
+struct synth_Tap
+{
+    float buffers[3][SYNTH_TAP_FRAMES * SYNTH_OUTPUT_CHANNELS];
+    int back;           // writer only
+    int filled;
+    int front;          // reader only
+    atomic_int middle;  // index with TAP_FRESH when not read yet
+};
+
+void synth_tapInit(struct synth_Tap *tap);
+
+// Audio thread, interleaved frames of SYNTH_OUTPUT_CHANNELS
+void synth_tapWrite(struct synth_Tap *tap, const float *input, int frames);
+// View thread, latest snapshot or NULL if nothing new was published
+const float *synth_tapRead(struct synth_Tap *tap);
+
+#endif /* SYNTH_TAP_H_ */
@@ -0,0 +1,805 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "synth_voices.h"
+
+// -------------------------- +Const --------------------------
+
+#define       PI                    ((float) M_PI)
+
+#define       VOICES_ALIGN          64
+#define       VOICES_INT_ARRAYS     6
+#define       VOICES_FLOAT_ARRAYS   (4 + 6 * PARTIALS_NUM)
+#define       VOICES_STACK_ARRAYS   (2 * PARTIALS_NUM)
+
+// Lanes of a stack start this far apart in phase, so a chord of them does not flange at the onset
+#define       STACK_PHASE_STEP      0.618034f
+
+// -------------------------- +Patches --------------------------
+
+const struct synth_Patch g_patches[SYNTH_PATCHES_NUM] =
+{
+    [SYNTH_PATCH_HARMONICA] =
+    {
+        { 0.05f, 1.0f, 0.1f, 1.0f, 0.95f }, 0.5f, 3,
+        {
+            { 1.00f, 0,  WAVE_TYPE_SQUARE, 5.0f, 0.001f, 50.0f },
+            { 0.50f, 12, WAVE_TYPE_SQUARE, 0.0f, 0.0f,   50.0f },
+            { 0.05f, 24, WAVE_TYPE_NOISE,  0.0f, 0.0f,   50.0f }
+        }
+    },
+    [SYNTH_PATCH_BELL] =
+    {
+        { 0.01f, 1.0f, 1.0f, 1.0f, 0.0f }, 0.5f, 3,
+        {
+            { 1.00f, 12, WAVE_TYPE_SINE, 5.0f, 0.001f, 50.0f },
+            { 0.50f, 24, WAVE_TYPE_SINE, 0.0f, 0.0f,   50.0f },
+            { 0.25f, 36, WAVE_TYPE_SINE, 0.0f, 0.0f,   50.0f }
+        }
+    }
+};
+
+// -------------------------- +Oscillator --------------------------
+
+extern inline float synth_scaleNote(const int note) { return 256 * powf(1.0594630943592952645618252949463f, note); }
+
+/*
+ * Oscillator math for the voice lanes is branch free: conditions only pick
+ * between constants, so the loops over voices vectorize without relaxing
+ * floating point semantics.
+ */
+
+// Fractional part, the result goes from 0 to 1 for any sign. Phases and
+// increments stay far below INT_MAX for notes up to SYNTH_NOTE_MAX
+extern inline float synth_wrap(const float phase)
+{
+    const float t = phase - (float) (int) phase;
+    return t + (t < 0.0f ? 1.0f : 0.0f);
+}
+
+// Sine of a phase in cycles, an odd polynomial after folding into a quarter period
+extern inline float synth_sine(const float phase)
+{
+    float t = synth_wrap(phase);
+    t += t >= 0.5f ? -1.0f : 0.0f;
+    const float u = 0.25f - fabsf(0.25f - fabsf(t));
+    const float y = copysignf(u, t) * 2.0f * PI;
+    const float y2 = y * y;
+    return y * (1.0f + y2 * (-1.0f / 6.0f + y2 * (1.0f / 120.0f + y2 * (-1.0f / 5040.0f + y2 * (1.0f / 362880.0f + y2 * (-1.0f / 39916800.0f))))));
+}
+
+// Xorshift keeps noise per engine instance, random() shares a locked global state
+float synth_noise(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return 2.0f * ((float) x / (float) UINT32_MAX) - 1.0f;
+}
+
+float synth_oscillate(const float phase, const enum synth_WaveType type, const float custom, uint32_t *noise)
+{
+    switch (type) {
+        case WAVE_TYPE_SINE: // Sine wave bewteen -1 and +1
+        {
+            return synth_sine(phase);
+        }
+        case WAVE_TYPE_SQUARE: // Square wave between -1 and +1
+        {
+            return phase < 0.5f ? 1.0f : -1.0f;
+        }
+        case WAVE_TYPE_TRIANGLE: // Triangle wave between -1 and +1
+        {
+            return asinf(sinf(phase * 2.0f * PI)) * (2.0f / PI);
+        }
+        case WAVE_TYPE_SAW_ANALOGUE: // Saw wave (analogue / warm / slow)
+        {
+            float dOutput = 0.0;
+            float  n = 1.0f;
+            while (n < custom) {
+                dOutput += synth_sine(n * phase) / n;
+                n += 1.0f;
+            }
+            return dOutput * (2.0f / PI);
+        }
+        case WAVE_TYPE_SAW_DIGITAL:
+        {
+            return 2.0f * phase - 1.0f;
+        }
+        case WAVE_TYPE_NOISE:
+        {
+            return synth_noise(noise);
+        }
+        case WAVE_TYPE_TRIANGLE_DIGITAL: // Same phase as the triangle above, without asinf and sinf
+        {
+            if (phase < 0.25f) {
+                return 4.0f * phase;
+            } else if (phase < 0.75f) {
+                return 2.0f - 4.0f * phase;
+            }
+            return 4.0f * phase - 4.0f;
+        }
+    }
+    return 0.0f;
+}
+
+// Cheaper waveform with the same character, used when the engine is overloaded
+enum synth_WaveType synth_oscillatorCheapVariant(const enum synth_WaveType type)
+{
+    switch (type) {
+        case WAVE_TYPE_TRIANGLE: return WAVE_TYPE_TRIANGLE_DIGITAL;
+        case WAVE_TYPE_SAW_ANALOGUE: return WAVE_TYPE_SAW_DIGITAL;
+        default: return type;
+    }
+}
+
+// Lower quality renders fewer partials, fewer harmonics of the analogue saw
+// and cheaper waveforms
+int synth_oscillatorResolvePartials(const struct synth_Patch *patch, const enum synth_Quality quality, struct synth_Partial *partials)
+{
+    int partialsNum = patch->partialsNum;
+    if (quality >= SYNTH_QUALITY_CHEAP) {
+        partialsNum = 1;
+    } else if (quality >= SYNTH_QUALITY_REDUCED && partialsNum > 1) {
+        partialsNum--;
+    }
+    for (int p = 0; p < partialsNum; p++) {
+        partials[p] = patch->partials[p];
+        if (quality >= SYNTH_QUALITY_REDUCED) {
+            partials[p].custom = fmaxf(2.0f, partials[p].custom / 2.0f);
+        }
+        if (quality >= SYNTH_QUALITY_CHEAP) {
+            partials[p].type = synth_oscillatorCheapVariant(partials[p].type);
+        }
+    }
+    return partialsNum;
+}
+
+// -------------------------- +Voices --------------------------
+
+bool synth_voicesCreate(struct synth_Voices *voices, const int capacity)
+{
+    assert(voices != NULL);
+    memset(voices, 0, sizeof(struct synth_Voices));
+    voices->capacity = (capacity + VOICES_LANES - 1) & ~(VOICES_LANES - 1);
+    const size_t arraySize = ((voices->capacity * sizeof(float) + VOICES_ALIGN - 1) / VOICES_ALIGN) * VOICES_ALIGN;
+    const size_t stackSize = arraySize * VOICES_LANES;
+    const size_t size = arraySize * (VOICES_INT_ARRAYS + VOICES_FLOAT_ARRAYS) + stackSize * VOICES_STACK_ARRAYS;
+    voices->memory = aligned_alloc(VOICES_ALIGN, size);
+    if (voices->memory == NULL) {
+        return false;
+    }
+    memset(voices->memory, 0, size);
+    char *memory = voices->memory;
+    voices->id = (int *) memory; memory += arraySize;
+    voices->age = (uint32_t *) memory; memory += arraySize;
+    voices->stage = (int *) memory; memory += arraySize;
+    voices->remaining = (int *) memory; memory += arraySize;
+    voices->position = (int *) memory; memory += arraySize;
+    voices->glideRemaining = (int *) memory; memory += arraySize;
+    voices->level = (float *) memory; memory += arraySize;
+    voices->rate = (float *) memory; memory += arraySize;
+    voices->gain = (float *) memory; memory += arraySize;
+    voices->glide = (float *) memory; memory += arraySize;
+    for (int p = 0; p < PARTIALS_NUM; p++) {
+        voices->phase[p] = (float *) memory; memory += arraySize;
+        voices->increment[p] = (float *) memory; memory += arraySize;
+        voices->lfoPhase[p] = (float *) memory; memory += arraySize;
+        voices->lfoIncrement[p] = (float *) memory; memory += arraySize;
+        voices->lfoDepth[p] = (float *) memory; memory += arraySize;
+        voices->modulation[p] = (float *) memory; memory += arraySize;
+        voices->stackPhase[p] = (float *) memory; memory += stackSize;
+        voices->stackIncrement[p] = (float *) memory; memory += stackSize;
+    }
+    synth_voicesSetUnison(voices, 1, 0.0f, 0.0f);
+    return true;
+}
+
+void synth_voicesDestroy(struct synth_Voices *voices)
+{
+    assert(voices != NULL);
+    free(voices->memory);
+    memset(voices, 0, sizeof(struct synth_Voices));
+}
+
+int synth_voicesFind(const struct synth_Voices *voices, const int id)
+{
+    for (int i = 0; i < voices->num; i++) {
+        if (voices->id[i] == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int synth_voicesFindAge(const struct synth_Voices *voices, const uint32_t age)
+{
+    for (int i = 0; i < voices->num; i++) {
+        if (voices->age[i] == age) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int synth_voicesStageSamples(const float time, const float sampleRate)
+{
+    const int samples = (int) (time * sampleRate);
+    return samples > 0 ? samples : 1;
+}
+
+void synth_voicesEnterStage(struct synth_Voices *voices, const struct synth_Patch *patch, const int index, const enum synth_EnvelopeStage stage, const float sampleRate)
+{
+    const struct synth_Envelope *envelope = &patch->envelope;
+    int samples = INT_MAX;
+    float rate = 0.0f;
+    switch (stage) {
+        case ENVELOPE_STAGE_ATTACK:
+        {
+            samples = synth_voicesStageSamples(envelope->attackTime, sampleRate);
+            rate = (envelope->startAmplitude - voices->level[index]) / (float) samples;
+            break;
+        }
+        case ENVELOPE_STAGE_DECAY:
+        {
+            voices->level[index] = envelope->startAmplitude;
+            samples = synth_voicesStageSamples(envelope->decayTime, sampleRate);
+            rate = (envelope->sustainAmplitude - envelope->startAmplitude) / (float) samples;
+            break;
+        }
+        case ENVELOPE_STAGE_SUSTAIN:
+        {
+            voices->level[index] = envelope->sustainAmplitude;
+            break;
+        }
+        case ENVELOPE_STAGE_RELEASE:
+        {
+            samples = synth_voicesStageSamples(envelope->releaseTime, sampleRate);
+            rate = -voices->level[index] / (float) samples;
+            break;
+        }
+    }
+    voices->stage[index] = stage;
+    voices->remaining[index] = samples;
+    voices->rate[index] = rate;
+}
+
+// Increment of the first partial, or of the sample, playing the note
+float synth_voicesNoteIncrement(const struct synth_Patch *patch, const struct synth_Sample *sample, const int note, const float sampleRate)
+{
+    if (sample != NULL) {
+        return synth_scaleNote(note) / sample->rootFreq * sample->rate / sampleRate;
+    }
+    return synth_scaleNote(note + patch->partials[0].noteOffset) / sampleRate;
+}
+
+void synth_voicesTuneStack(struct synth_Voices *voices, const int index)
+{
+    for (int p = 0; p < PARTIALS_NUM; p++) {
+        float *increment = voices->stackIncrement[p] + index * VOICES_LANES;
+        for (int l = 0; l < VOICES_LANES; l++) {
+            increment[l] = voices->increment[p][index] * voices->stackDetune[l];
+        }
+    }
+}
+
+// Exact increments of the note of the voice, glides end here so the rounding does not add up
+void synth_voicesTune(struct synth_Voices *voices, const struct synth_Patch *patch, const struct synth_Sample *sample, const int index, const float sampleRate)
+{
+    const int note = voices->id[index];
+    if (sample != NULL) {
+        voices->increment[0][index] = synth_voicesNoteIncrement(patch, sample, note, sampleRate);
+        return;
+    }
+    for (int p = 0; p < PARTIALS_NUM; p++) {
+        const struct synth_Partial *partial = &patch->partials[p];
+        const bool used = p < patch->partialsNum;
+        const float freq = used ? synth_scaleNote(note + partial->noteOffset) : 0.0f;
+        voices->increment[p][index] = freq / sampleRate;
+        voices->lfoDepth[p][index] = used ? partial->lfoAmplitude * freq / (2.0f * PI) : 0.0f;
+    }
+    synth_voicesTuneStack(voices, index);
+}
+
+int synth_voicesStart(struct synth_Voices *voices, const struct synth_Patch *patch, const int id, const uint32_t age, const float sampleRate)
+{
+    assert(id >= 0 && id <= SYNTH_NOTE_MAX);
+    if (voices->num >= voices->capacity) {
+        return -1;
+    }
+    const int index = voices->num++;
+    voices->id[index] = id;
+    voices->age[index] = age;
+    voices->position[index] = 0;
+    voices->level[index] = 0.0f;
+    voices->gain[index] = patch->volume;
+    voices->glide[index] = 1.0f;
+    voices->glideRemaining[index] = 0;
+    for (int p = 0; p < PARTIALS_NUM; p++) {
+        const bool used = p < patch->partialsNum;
+        voices->phase[p][index] = 0.0f;
+        voices->lfoPhase[p][index] = 0.0f;
+        voices->lfoIncrement[p][index] = used ? patch->partials[p].lfoFreq / sampleRate : 0.0f;
+        voices->modulation[p][index] = 0.0f;
+        float *phase = voices->stackPhase[p] + index * VOICES_LANES;
+        for (int l = 0; l < VOICES_LANES; l++) {
+            phase[l] = synth_wrap((float) l * STACK_PHASE_STEP);
+        }
+    }
+    synth_voicesTune(voices, patch, NULL, index, sampleRate);
+    synth_voicesEnterStage(voices, patch, index, ENVELOPE_STAGE_ATTACK, sampleRate);
+    return index;
+}
+
+// Attacks again from the current level, so a retrigger does not click
+void synth_voicesRetrigger(struct synth_Voices *voices, const struct synth_Patch *patch, const int index, const float sampleRate)
+{
+    synth_voicesEnterStage(voices, patch, index, ENVELOPE_STAGE_ATTACK, sampleRate);
+}
+
+void synth_voicesRelease(struct synth_Voices *voices, const struct synth_Patch *patch, const int index, const float sampleRate)
+{
+    synth_voicesEnterStage(voices, patch, index, ENVELOPE_STAGE_RELEASE, sampleRate);
+}
+
+// The last voice moves into the hole, its lane is silenced
+void synth_voicesRemove(struct synth_Voices *voices, const int index)
+{
+    assert(index >= 0 && index < voices->num);
+    if (voices->glideRemaining[index] > 0) {
+        voices->gliding--;
+    }
+    const int last = --voices->num;
+    voices->id[index] = voices->id[last];
+    voices->age[index] = voices->age[last];
+    voices->stage[index] = voices->stage[last];
+    voices->remaining[index] = voices->remaining[last];
+    voices->position[index] = voices->position[last];
+    voices->level[index] = voices->level[last];
+    voices->rate[index] = voices->rate[last];
+    voices->gain[index] = voices->gain[last];
+    voices->glide[index] = voices->glide[last];
+    voices->glideRemaining[index] = voices->glideRemaining[last];
+    voices->glideRemaining[last] = 0;
+    voices->level[last] = 0.0f;
+    voices->rate[last] = 0.0f;
+    voices->gain[last] = 0.0f;
+    for (int p = 0; p < PARTIALS_NUM; p++) {
+        voices->phase[p][index] = voices->phase[p][last];
+        voices->increment[p][index] = voices->increment[p][last];
+        voices->lfoPhase[p][index] = voices->lfoPhase[p][last];
+        voices->lfoIncrement[p][index] = voices->lfoIncrement[p][last];
+        voices->lfoDepth[p][index] = voices->lfoDepth[p][last];
+        voices->modulation[p][index] = voices->modulation[p][last];
+        voices->increment[p][last] = 0.0f;
+        voices->lfoIncrement[p][last] = 0.0f;
+        voices->lfoDepth[p][last] = 0.0f;
+        voices->modulation[p][last] = 0.0f;
+        memcpy(voices->stackPhase[p] + index * VOICES_LANES, voices->stackPhase[p] + last * VOICES_LANES, VOICES_LANES * sizeof(float));
+        memcpy(voices->stackIncrement[p] + index * VOICES_LANES, voices->stackIncrement[p] + last * VOICES_LANES, VOICES_LANES * sizeof(float));
+    }
+}
+
+void synth_voicesAttachSample(struct synth_Voices *voices, const struct synth_Sample *sample, const int index, const float sampleRate)
+{
+    assert(index >= 0 && index < voices->num);
+    voices->position[index] = 0;
+    voices->phase[0][index] = 0.0f;
+    voices->increment[0][index] = synth_voicesNoteIncrement(NULL, sample, voices->id[index], sampleRate);
+}
+
+void synth_voicesSetLfo(struct synth_Voices *voices, const int p, const float freq, const float amplitude, const float sampleRate)
+{
+    for (int k = 0; k < voices->num; k++) {
+        voices->lfoIncrement[p][k] = freq / sampleRate;
+        voices->lfoDepth[p][k] = amplitude * voices->increment[p][k] * sampleRate / (2.0f * PI);
+    }
+}
+
+void synth_voicesSetSustain(struct synth_Voices *voices, const float sustain, const int frames)
+{
+    for (int k = 0; k < voices->num; k++) {
+        if (voices->stage[k] == ENVELOPE_STAGE_DECAY) {
+            voices->rate[k] = (sustain - voices->level[k]) / (float) voices->remaining[k];
+        } else if (voices->stage[k] == ENVELOPE_STAGE_SUSTAIN && frames > 0) {
+            voices->rate[k] = (sustain - voices->level[k]) / (float) frames;
+            voices->remaining[k] = frames;
+        } else if (voices->stage[k] == ENVELOPE_STAGE_SUSTAIN) {
+            voices->level[k] = sustain;
+            voices->rate[k] = 0.0f;
+            voices->remaining[k] = INT_MAX;
+        }
+    }
+}
+
+void synth_voicesRescale(struct synth_Voices *voices, const float ratio)
+{
+    for (int k = 0; k < voices->num; k++) {
+        voices->rate[k] /= ratio;
+        // Sustaining voices count down from INT_MAX, the scaled count saturates
+        if (voices->remaining[k] != INT_MAX) {
+            const float scaled = (float) voices->remaining[k] * ratio;
+            const int remaining = scaled < (float) INT_MAX ? (int) scaled : INT_MAX;
+            voices->remaining[k] = remaining > 0 ? remaining : 1;
+        }
+        for (int p = 0; p < PARTIALS_NUM; p++) {
+            voices->increment[p][k] /= ratio;
+            voices->lfoIncrement[p][k] /= ratio;
+        }
+        synth_voicesTuneStack(voices, k);
+        if (voices->glideRemaining[k] > 0) {
+            const int remaining = (int) (voices->glideRemaining[k] * ratio);
+            voices->glideRemaining[k] = remaining > 0 ? remaining : 1;
+            voices->glide[k] = powf(voices->glide[k], 1.0f / ratio);
+        }
+    }
+}
+
+/*
+ * Lanes sit evenly from -1 to +1 across the stack, detuned by half the
+ * detune at the edges and panned with constant power by the spread. Every
+ * lane is weighted by 1/sqrt(unison), so the lanes, uncorrelated once
+ * detuned, add up to the power of one oscillator.
+ */
+void synth_voicesSetUnison(struct synth_Voices *voices, const int unison, const float detune, const float spread)
+{
+    assert(unison >= 1 && unison <= VOICES_LANES);
+    voices->unison = unison;
+    const float scale = 1.0f / sqrtf((float) unison);
+    for (int l = 0; l < VOICES_LANES; l++) {
+        const bool used = l < unison;
+        const float position = unison > 1 ? 2.0f * (float) l / (float) (unison - 1) - 1.0f : 0.0f;
+        const float angle = (position * spread + 1.0f) * (PI / 4.0f);
+        const float left = (float) M_SQRT2 * cosf(angle);
+        const float right = (float) M_SQRT2 * sinf(angle);
+        voices->stackDetune[l] = used ? powf(2.0f, position * detune / 2400.0f) : 0.0f;
+        voices->stackMid[l] = used ? scale * 0.5f * (left + right) : 0.0f;
+        voices->stackSide[l] = used ? scale * 0.5f * (left - right) : 0.0f;
+    }
+    for (int k = 0; k < voices->num; k++) {
+        synth_voicesTuneStack(voices, k);
+    }
+}
+
+void synth_voicesGlide(struct synth_Voices *voices, const struct synth_Patch *patch, const struct synth_Sample *sample, const int index, const int note, const int samples, const float sampleRate)
+{
+    assert(index >= 0 && index < voices->num);
+    const float from = voices->increment[0][index];
+    const float to = synth_voicesNoteIncrement(patch, sample, note, sampleRate);
+    voices->id[index] = note;
+    if (voices->glideRemaining[index] > 0) {
+        voices->gliding--;
+    }
+    assert(note >= 0 && note <= SYNTH_NOTE_MAX);
+    voices->glide[index] = 1.0f;
+    voices->glideRemaining[index] = 0;
+    if (samples <= 0 || from <= 0.0f || from == to) {
+        synth_voicesTune(voices, patch, sample, index, sampleRate);
+        return;
+    }
+    voices->glide[index] = powf(to / from, 1.0f / (float) samples);
+    voices->glideRemaining[index] = samples;
+    voices->gliding++;
+}
+
+void synth_voicesNextStage(struct synth_Voices *voices, const struct synth_Patch *patch, const int index, const float sampleRate)
+{
+    switch (voices->stage[index]) {
+        case ENVELOPE_STAGE_ATTACK: synth_voicesEnterStage(voices, patch, index, ENVELOPE_STAGE_DECAY, sampleRate); break;
+        case ENVELOPE_STAGE_DECAY: synth_voicesEnterStage(voices, patch, index, ENVELOPE_STAGE_SUSTAIN, sampleRate); break;
+        case ENVELOPE_STAGE_SUSTAIN: synth_voicesEnterStage(voices, patch, index, ENVELOPE_STAGE_SUSTAIN, sampleRate); break;
+        case ENVELOPE_STAGE_RELEASE: synth_voicesRemove(voices, index); break;
+    }
+}
+
+// -------------------------- +Mixer --------------------------
+
+float synth_voicesSumLanes(const float *lanes)
+{
+    float sum = 0.0f;
+    for (int l = 0; l < VOICES_LANES; l++) {
+        sum += lanes[l];
+    }
+    return sum;
+}
+
+// Mid of the stack lanes, the side goes out through side
+float synth_voicesWeighLanes(const struct synth_Voices *voices, const float *lanes, float *side)
+{
+    float mid = 0.0f;
+    *side = 0.0f;
+    for (int l = 0; l < VOICES_LANES; l++) {
+        mid += lanes[l] * voices->stackMid[l];
+        *side += lanes[l] * voices->stackSide[l];
+    }
+    return mid;
+}
+
+// Advances the LFOs of one partial, the phase offsets land in its modulation lanes
+void synth_voicesModulate(struct synth_Voices *voices, const int p, const int padded)
+{
+    const float *restrict lfoIncrement = voices->lfoIncrement[p];
+    const float *restrict lfoDepth = voices->lfoDepth[p];
+    float *restrict lfoPhase = voices->lfoPhase[p];
+    float *restrict modulation = voices->modulation[p];
+    for (int k = 0; k < padded; k++) {
+        modulation[k] = lfoDepth[k] * synth_sine(lfoPhase[k]);
+        lfoPhase[k] = synth_wrap(lfoPhase[k] + lfoIncrement[k]);
+    }
+}
+
+/*
+ * One sample of one partial across all voices. Every lane keeps its own
+ * partial sum, so the loop over lanes vectorizes without reassociating
+ * floating point additions.
+ */
+float synth_voicesMixSine(struct synth_Voices *voices, const int p, const int padded)
+{
+    const float *restrict level = voices->level;
+    const float *restrict gain = voices->gain;
+    const float *restrict increment = voices->increment[p];
+    const float *restrict modulation = voices->modulation[p];
+    float *restrict phase = voices->phase[p];
+    float lanes[VOICES_LANES] = { 0.0f };
+    for (int v = 0; v < padded; v += VOICES_LANES) {
+        for (int l = 0; l < VOICES_LANES; l++) {
+            const int k = v + l;
+            lanes[l] += level[k] * gain[k] * synth_sine(phase[k] + modulation[k]);
+            phase[k] = synth_wrap(phase[k] + increment[k]);
+        }
+    }
+    return synth_voicesSumLanes(lanes);
+}
+
+float synth_voicesMixSquare(struct synth_Voices *voices, const int p, const int padded)
+{
+    const float *restrict level = voices->level;
+    const float *restrict gain = voices->gain;
+    const float *restrict increment = voices->increment[p];
+    const float *restrict modulation = voices->modulation[p];
+    float *restrict phase = voices->phase[p];
+    float lanes[VOICES_LANES] = { 0.0f };
+    for (int v = 0; v < padded; v += VOICES_LANES) {
+        for (int l = 0; l < VOICES_LANES; l++) {
+            const int k = v + l;
+            lanes[l] += level[k] * gain[k] * (synth_wrap(phase[k] + modulation[k]) < 0.5f ? 1.0f : -1.0f);
+            phase[k] = synth_wrap(phase[k] + increment[k]);
+        }
+    }
+    return synth_voicesSumLanes(lanes);
+}
+
+// Everything else goes voice by voice through the generic oscillator
+float synth_voicesMixGeneric(struct synth_Voices *voices, const int p, const struct synth_Partial *partial, uint32_t *noise)
+{
+    float sum = 0.0f;
+    for (int k = 0; k < voices->num; k++) {
+        const float current = synth_wrap(voices->phase[p][k] + voices->modulation[p][k]);
+        sum += voices->level[k] * voices->gain[k] * synth_oscillate(current, partial->type, partial->custom, noise);
+        voices->phase[p][k] = synth_wrap(voices->phase[p][k] + voices->increment[p][k]);
+    }
+    return sum;
+}
+
+/*
+ * One sample of one partial across all unison stacks. The lanes of a stack
+ * share the amplitude and the LFO offset of their voice, they are summed
+ * per lane and weighted into mid and side once at the end.
+ */
+float synth_voicesMixStackSine(struct synth_Voices *voices, const int p, float *side)
+{
+    float lanes[VOICES_LANES] = { 0.0f };
+    for (int k = 0; k < voices->num; k++) {
+        const float amplitude = voices->level[k] * voices->gain[k];
+        const float offset = voices->modulation[p][k];
+        const float *restrict increment = voices->stackIncrement[p] + k * VOICES_LANES;
+        float *restrict phase = voices->stackPhase[p] + k * VOICES_LANES;
+        for (int l = 0; l < VOICES_LANES; l++) {
+            lanes[l] += amplitude * synth_sine(phase[l] + offset);
+            phase[l] = synth_wrap(phase[l] + increment[l]);
+        }
+    }
+    return synth_voicesWeighLanes(voices, lanes, side);
+}
+
+float synth_voicesMixStackSquare(struct synth_Voices *voices, const int p, float *side)
+{
+    float lanes[VOICES_LANES] = { 0.0f };
+    for (int k = 0; k < voices->num; k++) {
+        const float amplitude = voices->level[k] * voices->gain[k];
+        const float offset = voices->modulation[p][k];
+        const float *restrict increment = voices->stackIncrement[p] + k * VOICES_LANES;
+        float *restrict phase = voices->stackPhase[p] + k * VOICES_LANES;
+        for (int l = 0; l < VOICES_LANES; l++) {
+            lanes[l] += amplitude * (synth_wrap(phase[l] + offset) < 0.5f ? 1.0f : -1.0f);
+            phase[l] = synth_wrap(phase[l] + increment[l]);
+        }
+    }
+    return synth_voicesWeighLanes(voices, lanes, side);
+}
+
+float synth_voicesMixStackGeneric(struct synth_Voices *voices, const int p, const struct synth_Partial *partial, uint32_t *noise, float *side)
+{
+    float lanes[VOICES_LANES] = { 0.0f };
+    for (int k = 0; k < voices->num; k++) {
+        const float amplitude = voices->level[k] * voices->gain[k];
+        float *phase = voices->stackPhase[p] + k * VOICES_LANES;
+        for (int l = 0; l < voices->unison; l++) {
+            const float current = synth_wrap(phase[l] + voices->modulation[p][k]);
+            lanes[l] += amplitude * synth_oscillate(current, partial->type, partial->custom, noise);
+            phase[l] = synth_wrap(phase[l] + voices->stackIncrement[p][k * VOICES_LANES + l]);
+        }
+    }
+    return synth_voicesWeighLanes(voices, lanes, side);
+}
+
+// Cubic Hermite through the four frames around the position
+float synth_voicesInterpolate(const float xm1, const float x0, const float x1, const float x2, const float t)
+{
+    const float c1 = 0.5f * (x1 - xm1);
+    const float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+    const float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+    return ((c3 * t + c2) * t + c1) * t + x0;
+}
+
+// Sampler voices read frames through the loop and the mapping, they go voice by voice
+float synth_voicesMixSample(struct synth_Voices *voices, const struct synth_Sample *sample)
+{
+    float sum = 0.0f;
+    for (int k = 0; k < voices->num; k++) {
+        const int frame = voices->position[k];
+        const float current = synth_voicesInterpolate(synth_sampleFrame(sample, frame - 1), synth_sampleFrame(sample, frame),
+                                                      synth_sampleFrame(sample, frame + 1), synth_sampleFrame(sample, frame + 2), voices->phase[0][k]);
+        sum += voices->level[k] * voices->gain[k] * current;
+        const float phase = voices->phase[0][k] + voices->increment[0][k];
+        const int whole = (int) phase;
+        voices->position[k] = frame + whole;
+        voices->phase[0][k] = phase - (float) whole;
+    }
+    return sum;
+}
+
+// Looped positions wrap once they leave the loop, so they never overflow
+void synth_voicesWrapSample(struct synth_Voices *voices, const struct synth_Sample *sample, const int index)
+{
+    if (sample->looping && voices->position[index] >= sample->loopEnd) {
+        voices->position[index] = sample->loopStart + (voices->position[index] - sample->loopEnd) % (sample->loopEnd - sample->loopStart);
+    }
+}
+
+void synth_voicesStepEnvelopes(struct synth_Voices *voices, const int padded)
+{
+    float *level = voices->level;
+    const float *rate = voices->rate;
+    for (int k = 0; k < padded; k++) {
+        level[k] += rate[k];
+    }
+}
+
+// Voices that do not glide have a factor of 1, silent lanes an increment of 0.
+// The vibrato depth follows the pitch, it is a fraction of the increment
+void synth_voicesStepGlides(struct synth_Voices *voices, const int padded)
+{
+    const float *restrict glide = voices->glide;
+    for (int p = 0; p < PARTIALS_NUM; p++) {
+        float *restrict increment = voices->increment[p];
+        float *restrict lfoDepth = voices->lfoDepth[p];
+        for (int k = 0; k < padded; k++) {
+            increment[k] *= glide[k];
+            lfoDepth[k] *= glide[k];
+        }
+    }
+    for (int k = 0; voices->unison > 1 && k < voices->num; k++) {
+        for (int p = 0; p < PARTIALS_NUM; p++) {
+            float *restrict increment = voices->stackIncrement[p] + k * VOICES_LANES;
+            for (int l = 0; l < VOICES_LANES; l++) {
+                increment[l] *= glide[k];
+            }
+        }
+    }
+}
+
+// One sample of every partial, the stacks add their side to side
+float synth_voicesMixPartials(struct synth_Voices *voices, const struct synth_Partial *partials, const int partialsNum, const int padded, uint32_t *noise, float *side)
+{
+    const bool stacked = voices->unison > 1;
+    float value = 0.0f;
+    *side = 0.0f;
+    for (int p = 0; p < partialsNum; p++) {
+        const struct synth_Partial *partial = &partials[p];
+        if (partial->lfoAmplitude != 0.0f) {
+            synth_voicesModulate(voices, p, padded);
+        }
+        float stackSide = 0.0f;
+        switch (partial->type) {
+            case WAVE_TYPE_SINE: value += partial->gain * (stacked ? synth_voicesMixStackSine(voices, p, &stackSide) : synth_voicesMixSine(voices, p, padded)); break;
+            case WAVE_TYPE_SQUARE: value += partial->gain * (stacked ? synth_voicesMixStackSquare(voices, p, &stackSide) : synth_voicesMixSquare(voices, p, padded)); break;
+            default: value += partial->gain * (stacked ? synth_voicesMixStackGeneric(voices, p, partial, noise, &stackSide) : synth_voicesMixGeneric(voices, p, partial, noise)); break;
+        }
+        *side += partial->gain * stackSide;
+    }
+    return value;
+}
+
+/*
+ * The block is split where the first envelope changes its stage or the
+ * first glide ends, inside such a chunk every voice is a plain linear ramp
+ * and no lane branches. Profiling reads the clock once per chunk, the ramp
+ * is stepped with the oscillators and counts as theirs, the envelope stage
+ * is the stage changes between chunks.
+ */
+void synth_voicesRender(struct synth_Voices *voices, const struct synth_Patch *patch, const struct synth_Sample *sample, const enum synth_Quality quality, const float sampleRate, uint32_t *noise, float *buffer, float *side, const int frames)
+{
+    assert(voices != NULL);
+    assert(patch != NULL);
+    struct synth_Partial partials[PARTIALS_NUM];
+    const int partialsNum = synth_oscillatorResolvePartials(patch, quality, partials);
+    int done = 0;
+    while (done < frames) {
+        if (voices->num == 0) {
+            memset(buffer + done, 0, (frames - done) * sizeof(float));
+            if (side != NULL) {
+                memset(side + done, 0, (frames - done) * sizeof(float));
+            }
+            break;
+        }
+        const int padded = (voices->num + VOICES_LANES - 1) & ~(VOICES_LANES - 1);
+        int chunk = frames - done;
+        for (int k = 0; k < voices->num; k++) {
+            if (voices->remaining[k] < chunk) {
+                chunk = voices->remaining[k];
+            }
+            if (voices->glideRemaining[k] > 0 && voices->glideRemaining[k] < chunk) {
+                chunk = voices->glideRemaining[k];
+            }
+        }
+        PROFILE_MARK(mark);
+        for (int i = 0; i < chunk; i++) {
+            float value = 0.0f;
+            float sideValue = 0.0f;
+            if (sample != NULL) {
+                value = synth_voicesMixSample(voices, sample);
+            } else {
+                value = synth_voicesMixPartials(voices, partials, partialsNum, padded, noise, &sideValue);
+            }
+            buffer[done + i] = value;
+            if (side != NULL) {
+                side[done + i] = sideValue;
+            }
+            if (voices->gliding > 0) {
+                synth_voicesStepGlides(voices, padded);
+            }
+            synth_voicesStepEnvelopes(voices, padded);
+        }
+        PROFILE_LAP(voices->profile, SYNTH_STAGE_OSCILLATOR, mark);
+        PROFILE_VOICES(voices->profile, voices->num * chunk);
+        for (int k = voices->num - 1; k >= 0; k--) {
+            if (voices->glideRemaining[k] > 0) {
+                voices->glideRemaining[k] -= chunk;
+                if (voices->glideRemaining[k] == 0) {
+                    voices->glide[k] = 1.0f;
+                    voices->gliding--;
+                    synth_voicesTune(voices, patch, sample, k, sampleRate);
+                }
+            }
+            if (sample != NULL) {
+                synth_voicesWrapSample(voices, sample, k);
+                if (!sample->looping && voices->position[k] >= sample->frames) {
+                    synth_voicesRemove(voices, k);
+                    continue;
+                }
+            }
+            voices->remaining[k] -= chunk;
+            if (voices->remaining[k] == 0) {
+                synth_voicesNextStage(voices, patch, k, sampleRate);
+            }
+        }
+        PROFILE_LAP(voices->profile, SYNTH_STAGE_ENVELOPE, mark);
+        done += chunk;
+    }
+}
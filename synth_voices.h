@@ -0,0 +1,153 @@
+#ifndef SYNTH_VOICES_H_
+#define SYNTH_VOICES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "synth.h"
+#include "synth_profile.h"
+#include "synth_sample.h"
+
+// -------------------------- +Const --------------------------
+
+#define       PARTIALS_NUM          3
+
+// Voices are processed in groups of VOICES_LANES, capacities are padded to it
+#define       VOICES_LANES          8
+
+_Static_assert(SYNTH_UNISON_MAX == VOICES_LANES, "A unison stack is one group of lanes");
+
+// -------------------------- +Patches --------------------------
+
+enum synth_WaveType
+{
+    WAVE_TYPE_SINE,
+    WAVE_TYPE_SQUARE,
+    WAVE_TYPE_TRIANGLE,
+    WAVE_TYPE_SAW_ANALOGUE,
+    WAVE_TYPE_SAW_DIGITAL,
+    WAVE_TYPE_NOISE,
+    WAVE_TYPE_TRIANGLE_DIGITAL
+};
+
+struct synth_Envelope
+{
+    float attackTime;
+    float decayTime;
+    float releaseTime;
+    float startAmplitude;
+    float sustainAmplitude;
+};
+
+struct synth_Partial
+{
+    float gain;
+    int noteOffset;
+    enum synth_WaveType type;
+    float lfoFreq;
+    float lfoAmplitude;
+    float custom;
+};
+
+struct synth_Patch
+{
+    struct synth_Envelope envelope;
+    float volume;
+    int partialsNum;
+    struct synth_Partial partials[PARTIALS_NUM];
+};
+
+extern const struct synth_Patch g_patches[SYNTH_PATCHES_NUM];
+
+// -------------------------- +Voices --------------------------
+
+enum synth_EnvelopeStage
+{
+    ENVELOPE_STAGE_ATTACK,
+    ENVELOPE_STAGE_DECAY,
+    ENVELOPE_STAGE_SUSTAIN,
+    ENVELOPE_STAGE_RELEASE
+};
+
+/*
+ * Active voices of one part in structure-of-arrays form. Active voices are
+ * packed at the front, the lanes up to the padded count stay silent, so the
+ * mixer streams linearly through every array and processes VOICES_LANES
+ * voices per step.
+ *
+ * Envelopes are linear segments: a per-sample rate and the samples left
+ * until the next stage. Oscillators are phase accumulators, phases go from
+ * 0 to 1. Sampler voices play through the first partial: the position is
+ * the frame in the sample, the phase the fraction past it and the
+ * increment the frames per output sample.
+ *
+ * With unison above 1 every voice owns VOICES_LANES more oscillators per
+ * partial, lanes of the stack are detuned from the increment of the voice
+ * and weighted into a mid and a side sum, unused lanes weigh nothing. The
+ * envelope, the gain and the LFOs stay per voice, a stack renders as one
+ * group of lanes. Gliding voices multiply all their increments by a
+ * constant factor every sample until they reach the pitch of their note.
+ */
+struct synth_Voices
+{
+    int num;
+    int capacity;
+    void *memory;
+    int *id;
+    uint32_t *age;
+    int *stage;
+    int *remaining;
+    int *position;
+    float *level;
+    float *rate;
+    float *gain;
+    float *phase[PARTIALS_NUM];
+    float *increment[PARTIALS_NUM];
+    float *lfoPhase[PARTIALS_NUM];
+    float *lfoIncrement[PARTIALS_NUM];
+    float *lfoDepth[PARTIALS_NUM];
+    float *modulation[PARTIALS_NUM];
+    float *glide;
+    int *glideRemaining;
+    int gliding;
+    float *stackPhase[PARTIALS_NUM];    // VOICES_LANES per voice
+    float *stackIncrement[PARTIALS_NUM];
+    int unison;
+    float stackDetune[VOICES_LANES];    // increment ratio of every lane
+    float stackMid[VOICES_LANES];
+    float stackSide[VOICES_LANES];
+    struct synth_ProfileBlock *profile; // oscillator and envelope time goes here, may be NULL
+};
+
+bool synth_voicesCreate(struct synth_Voices *voices, int capacity);
+void synth_voicesDestroy(struct synth_Voices *voices);
+
+// Index of the active voice playing the note or -1
+int synth_voicesFind(const struct synth_Voices *voices, int id);
+// Index of the voice started with the age or -1, ages tell voices of the same note apart
+int synth_voicesFindAge(const struct synth_Voices *voices, uint32_t age);
+
+// Index of the new voice or -1 when the capacity is exhausted
+int synth_voicesStart(struct synth_Voices *voices, const struct synth_Patch *patch, int id, uint32_t age, float sampleRate);
+void synth_voicesRetrigger(struct synth_Voices *voices, const struct synth_Patch *patch, int index, float sampleRate);
+void synth_voicesRelease(struct synth_Voices *voices, const struct synth_Patch *patch, int index, float sampleRate);
+void synth_voicesRemove(struct synth_Voices *voices, int index);
+// Plays the sample from its start instead of the oscillators, pitched from its root note
+void synth_voicesAttachSample(struct synth_Voices *voices, const struct synth_Sample *sample, int index, float sampleRate);
+// Active voices follow a new LFO of the partial, the depth scales with their pitch
+void synth_voicesSetLfo(struct synth_Voices *voices, int p, float freq, float amplitude, float sampleRate);
+// Decaying voices head for the new sustain level, sustaining voices ramp to it over the frames
+void synth_voicesSetSustain(struct synth_Voices *voices, float sustain, int frames);
+// Active voices keep their pitch and timing when the sample rate is multiplied by ratio
+void synth_voicesRescale(struct synth_Voices *voices, float ratio);
+// Stacks of active voices follow at once, detune is in cents and spread goes from 0 to 1
+void synth_voicesSetUnison(struct synth_Voices *voices, int unison, float detune, float spread);
+// The voice plays the note from now on, sliding over samples from its current pitch
+void synth_voicesGlide(struct synth_Voices *voices, const struct synth_Patch *patch, const struct synth_Sample *sample, int index, int note, int samples, float sampleRate);
+
+// Overwrites the buffer with one block of all voices, finished voices are removed.
+// Voices play the sample instead of the partials when it is not NULL. Side takes
+// the side signal of unison stacks when it is not NULL, the buffer is the mid
+void synth_voicesRender(struct synth_Voices *voices, const struct synth_Patch *patch, const struct synth_Sample *sample, enum synth_Quality quality, float sampleRate, uint32_t *noise, float *buffer, float *side, int frames);
+
+#endif /* SYNTH_VOICES_H_ */